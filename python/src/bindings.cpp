@@ -238,6 +238,15 @@ namespace pyblack {
       py::arg("timeout") = py::none{}
     );
 
+    solver.def_property(
+      "sat_backend", &black::solver::sat_backend, 
+      &black::solver::set_sat_backend
+    );
+    solver.def("set_backend_option", &black::solver::set_backend_option,
+      py::arg("key"), py::arg("value")
+    );
+    solver.def("clear_backend_options", &black::solver::clear_backend_options);
+
     solver.def_property_readonly("model", &black::solver::model);
     model.def_property_readonly("size", &black::model::size);
     model.def_property_readonly("loop", &black::model::loop);
@@ -26,6 +26,7 @@
 
 #include <string>
 #include <optional>
+#include <vector>
 #include <cstdint>
 
 namespace black::frontend
@@ -73,6 +74,15 @@ namespace black::frontend
     // name of the selected SAT backend (nullopt for default)
     inline std::optional<std::string> sat_backend;
 
+    // names of the SAT backends to run in parallel (empty if not given)
+    inline std::vector<std::string> portfolio;
+
+    // name of the selected encoding of loops (nullopt for default)
+    inline std::optional<std::string> loop_encoding;
+
+    // tuning options for the SAT backends, as `key=value` strings
+    inline std::vector<std::string> backend_options;
+
     // domain for first-order variables
     inline std::optional<std::string> default_sort;
 
@@ -28,6 +28,7 @@
 #include <black/support/license.hpp>
 
 #include <sstream>
+#include <algorithm>
 
 #include <clipp.h>
 
@@ -114,10 +115,36 @@ namespace black::frontend
     return black::sat::solver::backend_exists(name);
   }
 
+  static std::vector<std::string> split_list(std::string const &list) {
+    std::vector<std::string> result;
+    std::stringstream str{list};
+    std::string elem;
+    while(std::getline(str, elem, ','))
+      result.push_back(elem);
+
+    return result;
+  }
+
+  static bool is_portfolio(std::string const &list) {
+    std::vector<std::string> backends = split_list(list);
+    
+    return !backends.empty() && 
+      std::all_of(backends.begin(), backends.end(), is_backend);
+  }
+
+  static bool is_backend_option(std::string const &option) {
+    size_t eq = option.find('=');
+    return eq != std::string::npos && eq > 0; // LCOV_EXCL_LINE
+  }
+
   static bool is_output_format(std::string const &format) {
     return format == "readable" || format == "json"; // LCOV_EXCL_LINE
   }
 
+  static bool is_loop_encoding(std::string const &encoding) {
+    return encoding == "pairwise" || encoding == "compact"; // LCOV_EXCL_LINE
+  }
+
   //
   // main command-line parsing entry-point
   //
@@ -128,6 +155,7 @@ namespace black::frontend
     bool help = false;
     bool version = false;
     bool show_backends = false;
+    std::string portfolio;
 
     auto cli = "solving mode: " % (
       command("solve"),
@@ -136,6 +164,19 @@ namespace black::frontend
       (option("-B", "--sat-backend") 
         & value(is_backend, "backend", cli::sat_backend))
         % "select the SAT backend to use",
+      (option("--portfolio") 
+        & value(is_portfolio, "backends", portfolio))
+        % "run the given comma-separated list of SAT backends in parallel, "
+          "taking the answer of the first one to finish",
+      (option("--loop-encoding") 
+        & value(is_loop_encoding, "encoding", cli::loop_encoding))
+        % "select the encoding of the loops of the models.\n"
+          "Accepted encodings: pairwise, compact\n"
+          "Default: pairwise",
+      repeatable(option("--backend-option") 
+        & value(is_backend_option, "key=value", cli::backend_options))
+        % "set a tuning option of the SAT backend. Can be repeated.\n"
+          "The accepted options depend on the backend.",
       option("--remove-past").set(cli::remove_past)
         % "translate LTL+Past formulas into LTL before checking satisfiability",
       option("--finite").set(cli::finite)
@@ -207,6 +248,8 @@ namespace black::frontend
       quit(status_code::command_line_error);
     }
 
+    cli::portfolio = split_list(portfolio);
+
     if(help) {
       print_help(cli);
       quit(status_code::success);
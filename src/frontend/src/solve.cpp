@@ -78,7 +78,9 @@ namespace black::frontend {
 
   int solve(std::optional<std::string> const&path, std::istream &file)
   {
-    black::alphabet sigma;
+    // with a portfolio, the runs share the alphabet from different threads
+    black::alphabet sigma = cli::portfolio.empty() ? 
+      black::alphabet{} : black::alphabet{black::alphabet::concurrent};
     std::optional<formula> f;
 
     f = black::parse_formula(sigma, file, formula_syntax_error_handler(path));
@@ -117,27 +119,33 @@ namespace black::frontend {
     if(features & feature_t::first_order)
       cli::finite = true;
 
-    if((features & feature_t::first_order) && 
-       !black::sat::solver::backend_has_feature(backend, 
-          black::sat::feature::smt))
-    {
-      io::errorln(
-        "{}: the `{}` backend does not support first-order formulas.",
-        cli::command_name, backend
-      ); // LCOV_EXCL_LINE
-      quit(status_code::failure);
-    }
+    std::vector<std::string> backends = cli::portfolio;
+    if(backends.empty())
+      backends.push_back(backend);
 
-    if((features & feature_t::quantifiers) && 
-       !black::sat::solver::backend_has_feature(backend, 
-          black::sat::feature::quantifiers))
-    {
-      io::errorln(
-        "{}: the `{}` backend does not support "
-        "quantified first-order formulas.",
-        cli::command_name, backend
-      ); // LCOV_EXCL_LINE
-      quit(status_code::failure);
+    for(auto const& name : backends) {
+      if((features & feature_t::first_order) && 
+        !black::sat::solver::backend_has_feature(name, 
+            black::sat::feature::smt))
+      {
+        io::errorln(
+          "{}: the `{}` backend does not support first-order formulas.",
+          cli::command_name, name
+        ); // LCOV_EXCL_LINE
+        quit(status_code::failure);
+      }
+
+      if((features & feature_t::quantifiers) && 
+        !black::sat::solver::backend_has_feature(name, 
+            black::sat::feature::quantifiers))
+      {
+        io::errorln(
+          "{}: the `{}` backend does not support "
+          "quantified first-order formulas.",
+          cli::command_name, name
+        ); // LCOV_EXCL_LINE
+        quit(status_code::failure);
+      }
     }
 
     if(cli::print_model && (features & feature_t::first_order)) {
@@ -175,6 +183,26 @@ namespace black::frontend {
     black::solver slv;
 
     slv.set_sat_backend(backend);
+    slv.set_portfolio(cli::portfolio);
+    if(cli::loop_encoding == "compact")
+      slv.set_loop_encoding(black::loop_encoding::compact);
+
+    // with a portfolio, it suffices that one of the backends accepts each
+    // option
+    for(auto const& option : cli::backend_options) {
+      size_t eq = option.find('=');
+      std::string key = option.substr(0, eq);
+      black::sat::option_value value = 
+        black::sat::parse_option_value(option.substr(eq + 1));
+
+      if(!slv.set_backend_option(key, value)) {
+        io::errorln(
+          "{}: unsupported or invalid SAT backend option: `{}`",
+          cli::command_name, option
+        );
+        quit(status_code::failure);
+      }
+    }
 
     if(!cli::debug.empty())
       slv.set_tracer(&trace);
@@ -298,24 +326,24 @@ namespace black::frontend {
     std::unordered_set<proposition> props;
     relevant_props(f, props);
     
-    size_t size = solver.model()->size();
-    size_t width = static_cast<size_t>(log10((double)size)) + 1;
-    for(size_t t = 0; t < size; ++t) {
+    auto trace = solver.model()->values({props.begin(), props.end()});
+    size_t width = static_cast<size_t>(log10((double)trace.size)) + 1;
+    for(size_t t = 0; t < trace.size; ++t) {
       io::print("- t = {:>{}}: {{", t, width);
       bool first = true;
-      for(proposition a : props) {
-        tribool v = solver.model()->value(a, t);
+      for(size_t i = 0; i < trace.props.size(); ++i) {
+        tribool v = trace.value(i, t);
         const char *comma = first ? "" : ", ";
         if(v == true) {
-          io::print("{}{}", comma, to_string(a));
+          io::print("{}{}", comma, to_string(trace.props[i]));
           first = false;
         } else if(v == false) {
-          io::print("{}￢{}", comma, to_string(a));
+          io::print("{}￢{}", comma, to_string(trace.props[i]));
           first = false;
         }
       }
       io::print("}}");
-      if(solver.model()->loop() == t)
+      if(trace.loop == t)
         io::print(" ⬅︎ loops here");
       io::print("\n");
     }
@@ -353,33 +381,31 @@ namespace black::frontend {
     }
 
     if(model_exists == true && cli::print_model) {
-      auto model = solver.model();
       std::unordered_set<proposition> props;
       relevant_props(f, props);
+      auto trace = solver.model()->values({props.begin(), props.end()});
 
       io::println("    \"model\": {{");
-      io::println("        \"size\": {},", model->size());
+      io::println("        \"size\": {},", trace.size);
       if(!cli::finite)
-        io::println("        \"loop\": {},", model->loop());
+        io::println("        \"loop\": {},", trace.loop);
 
       io::println("        \"states\": [");
 
-      for(size_t t = 0; t < model->size(); ++t) {
+      for(size_t t = 0; t < trace.size; ++t) {
         io::println("            {{");
 
-        size_t i = 0;
-        for(proposition a : props) {
-          tribool v = model->value(a, t);
+        for(size_t i = 0; i < trace.props.size(); ++i) {
+          tribool v = trace.value(i, t);
           io::println("                \"{}\": \"{}\"{}",
-            to_string(a),
+            to_string(trace.props[i]),
             v == tribool::undef ? "undef" :
             v == true           ? "true" : "false",
-            i < props.size() - 1 ? "," : ""
+            i < trace.props.size() - 1 ? "," : ""
           );
-          ++i;
         }
 
-        io::println("            }}{}", t < model->size() - 1 ? "," : "");
+        io::println("            }}{}", t < trace.size - 1 ? "," : "");
       }
 
       io::println("        ]");
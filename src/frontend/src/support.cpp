@@ -96,76 +96,33 @@ namespace black::frontend
   }
 
 
-  static bool has_next(term t) {
-    return has_any_element_of(t, 
-      syntax_element::next, syntax_element::wnext,
-      syntax_element::prev, syntax_element::wprev
-    );
-  }
-
   uint8_t formula_features(formula f) {
-    return f.match(
-      [](boolean) -> uint8_t { return 0; },
-      [](proposition) -> uint8_t { return 0; },
-      [](atom a) -> uint8_t {
-        uint8_t nextvar = 0;
-        for(term t : a.terms())
-          if(has_next(t))
-            nextvar = (uint8_t)feature_t::nextvar;
-        return nextvar | (uint8_t)feature_t::first_order;
-      },
-      [](equality, auto terms) -> uint8_t {
-        for(auto t : terms)
-          if(has_next(t))
-            return 
-              (uint8_t)feature_t::nextvar | (uint8_t)feature_t::first_order;
-
-        return (uint8_t)feature_t::first_order;
-      },
-      [](comparison, term left, term right) -> uint8_t {
-        if(has_next(left) || has_next(right))
-          return (uint8_t)feature_t::nextvar | (uint8_t)feature_t::first_order;
-        return (uint8_t)feature_t::first_order;
-      },
-      [](quantifier q) -> uint8_t { // LCOV_EXCL_LINE
-        return (uint8_t)feature_t::first_order |
-               (uint8_t)feature_t::quantifiers |
-               formula_features(q.matrix());
-      },
-      [](only<temporal> t) -> uint8_t {
-        return (uint8_t)feature_t::temporal |
-          t.match(
-            [](only<past>) -> uint8_t { return (int8_t)feature_t::past; },
-            [](otherwise) -> uint8_t { return 0; }
-          ) | t.match(
-            [](unary, formula arg) -> uint8_t {
-              return formula_features(arg);
-            },
-            [](binary, formula left, formula right) -> uint8_t {
-              return formula_features(left) | formula_features(right);
-            }
-          );
-      },
-      [](unary, formula arg) -> uint8_t { 
-        return formula_features(arg);
-      },
-      [](disjunction d) {
-        uint8_t features = 0;
-        for(formula op : d.operands())
-          features = features | formula_features(op);
-        
-        return features;
-      },
-      [](conjunction d) {
-        uint8_t features = 0;
-        for(formula op : d.operands())
-          features = features | formula_features(op);
-        
-        return features;
-      },
-      [](binary, formula left, formula right) -> uint8_t {
-        return formula_features(left) | formula_features(right);
-      }
-    );
+    uint8_t features = 0;
+
+    if(has_any_element_of<temporal>(f))
+      features |= (uint8_t)feature_t::temporal;
+    
+    if(has_any_element_of<past>(f))
+      features |= (uint8_t)feature_t::past;
+
+    if(has_any_element_of(f, 
+        syntax_element::atom, 
+        syntax_element::equal, syntax_element::distinct,
+        syntax_element::less_than, syntax_element::less_than_equal,
+        syntax_element::greater_than, syntax_element::greater_than_equal,
+        syntax_element::exists, syntax_element::forall
+      ))
+      features |= (uint8_t)feature_t::first_order;
+
+    if(has_any_element_of(f, syntax_element::exists, syntax_element::forall))
+      features |= (uint8_t)feature_t::quantifiers;
+
+    if(has_any_element_of(f, 
+        syntax_element::next, syntax_element::wnext,
+        syntax_element::prev, syntax_element::wprev
+      ))
+      features |= (uint8_t)feature_t::nextvar;
+
+    return features;
   }
 }
@@ -35,7 +35,9 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <functional>
 #include <optional>
+#include <unordered_map>
 
 #include <nlohmann/json.hpp>
 
@@ -52,74 +54,6 @@ namespace black::frontend
     std::optional<formula> muc;
   };
 
-  static bool check(trace_t, formula, size_t);
-
-  static
-  std::optional<state_t> state_at(trace_t trace, size_t t) {
-    if(t < trace.loop)
-      return trace.states[t];
-    
-    size_t period = trace.states.size() - trace.loop;
-
-    if(period)
-      return trace.states[((t - trace.loop) % period) + trace.loop];
-    
-    black_assert(t >= trace.states.size());
-    return {};
-  }
-
-  static
-  bool check_proposition(trace_t trace, proposition a, size_t t) {
-    black_assert(a.name().to<std::string>().has_value());
-    std::string p = *a.name().to<std::string>();
-
-    std::optional<state_t> state = state_at(trace, t);
-    
-    // all the states at the end of a non-looping model are
-    // full of don't cares so we return true (we may choose false as well)
-    if(!state.has_value())
-      return true;
-      
-    auto it = state->find(p);
-    if(it == state->end())
-      return true;
-    
-    black::tribool value = it->second;
-    if(value == true || value == black::tribool::undef)
-      return true;
-
-    return false;
-  }
-
-  static
-  std::optional<size_t>
-  find_one(trace_t trace, formula f, size_t begin, size_t end) {
-    for(size_t i = begin; i < end; ++i) {
-      if(check(trace, f, i))
-        return i;
-    }
-    return {};
-  }
-
-  static
-  std::optional<size_t>
-  find_one_reverse(trace_t trace, formula f, size_t begin, size_t end) {
-    for(ssize_t i = (ssize_t)begin; i >= (ssize_t)end; --i) {
-      if(check(trace, f, (size_t)i))
-        return i;
-    }
-    return {};
-  }
-
-  static
-  bool check_for_all(trace_t trace, formula f, size_t begin, size_t end) {
-    for(size_t i = begin; i < end; ++i) {
-      if(!check(trace, f, i))
-        return false;
-    }
-    return true;
-  }
-
   static
   size_t depth(formula f) {
     return f.match(
@@ -148,162 +82,361 @@ namespace black::frontend
     );
   }
 
+  //
+  // The truth values of a formula at all the time steps of the (unrolled)
+  // trace, 64 time steps per word. Bits past the end of the trace are zero.
+  //
+  using bits_t = std::vector<uint64_t>;
+
   static
-  bool check_until(trace_t trace, until u, size_t t) {
-    formula l = u.left();
-    formula r = u.right();
+  uint64_t reverse_bits(uint64_t w) {
+    w = ((w >> 1) & 0x5555555555555555) | ((w & 0x5555555555555555) << 1);
+    w = ((w >> 2) & 0x3333333333333333) | ((w & 0x3333333333333333) << 2);
+    w = ((w >> 4) & 0x0F0F0F0F0F0F0F0F) | ((w & 0x0F0F0F0F0F0F0F0F) << 4);
+    w = ((w >> 8) & 0x00FF00FF00FF00FF) | ((w & 0x00FF00FF00FF00FF) << 8);
+    w = ((w >> 16) & 0x0000FFFF0000FFFF) | ((w & 0x0000FFFF0000FFFF) << 16);
+    return (w >> 32) | (w << 32);
+  }
 
-    size_t period = trace.states.size() - trace.loop;
-    size_t d = depth(u);
-    black_assert(d >= 1);
+  //
+  // Evaluates each subformula only once, bottom-up, over the whole trace.
+  //
+  // The loop of the trace is unrolled until the values of all the 
+  // subformulas become periodic, which needs one more iteration of the loop
+  // for each level of nesting of past operators. After that, the successor
+  // of the last position is the first position of the last unrolled period.
+  // Finite traces, and infinite ones without a loop, are instead followed by
+  // states where every proposition is true (they are all don't cares), but
+  // where no until is fulfilled. These become constant after the nesting 
+  // depth of past operators, so a single extra state looping on itself 
+  // suffices.
+  //
+  // Temporal operators are evaluated 64 time steps at a time: the
+  // tomorrow/yesterday operators are shifts, while since and until are 
+  // computed as the carries of an addition, propagated respectively 
+  // forward and (on the reversed words) backward.
+  //
+  class trace_checker 
+  {
+  public:
+    trace_checker(trace_t const& trace, formula f) : _trace{trace} {
+      size_t d = depth(f);
+      _period = trace.states.size() - trace.loop;
+      if(_period) {
+        _horizon = trace.states.size() + d * _period;
+        _back = _horizon - _period;
+      } else {
+        _horizon = trace.states.size() + d + 1;
+        _back = _horizon - 1;
+      }
+      _words = (_horizon + 63) / 64;
+    }
 
-    size_t end = std::max(t, trace.states.size()) + period + (period * d);
+    bool check(formula f, size_t t) {
+      return get(eval(f), position(t));
+    }
 
-    // search for 'r'
-    std::optional<size_t> rindex = find_one(trace, r, t, end);
-    
-    if(!rindex.has_value())
-      return false; // we didn't find 'r', the formula is false
+  private:
+    size_t position(size_t t) const {
+      if(t < _horizon)
+        return t;
+      if(_period)
+        return _back + (t - _back) % _period;
+      return _back;
+    }
+
+    static bool get(bits_t const& b, size_t t) {
+      return (b[t / 64] >> (t % 64)) & 1;
+    }
+
+    static void set(bits_t &b, size_t t, bool value) {
+      if(value)
+        b[t / 64] |= uint64_t{1} << (t % 64);
+      else
+        b[t / 64] &= ~(uint64_t{1} << (t % 64));
+    }
+
+    // clears the bits past the end of the trace
+    bits_t &trim(bits_t &b) const {
+      if(_horizon % 64)
+        b.back() &= (uint64_t{1} << (_horizon % 64)) - 1;
+      return b;
+    }
+
+    // the time steps before `n`
+    bits_t prefix(size_t n) const {
+      bits_t result(_words, 0);
+      for(size_t w = 0; w < n / 64; ++w)
+        result[w] = ~uint64_t{0};
+      if(n % 64)
+        result[n / 64] = (uint64_t{1} << (n % 64)) - 1;
+      return result;
+    }
+
+    bits_t constant(bool value) const {
+      bits_t result(_words, value ? ~uint64_t{0} : 0);
+      return trim(result);
+    }
+
+    bits_t negate(bits_t b) const {
+      for(uint64_t &w : b)
+        w = ~w;
+      return trim(b);
+    }
+
+    template<typename Op>
+    static bits_t combine(bits_t l, bits_t const& r, Op op) {
+      for(size_t w = 0; w < l.size(); ++w)
+        l[w] = op(l[w], r[w]);
+      return l;
+    }
+
+    bits_t proposition_bits(proposition a) const;
+    bits_t tomorrow_bits(bits_t const& op) const;
+    bits_t yesterday_bits(bits_t const& op) const;
+    bits_t since_bits(bits_t const& l, bits_t const& r) const;
+    bits_t until_bits(bits_t const& l, bits_t const& r, bool boundary) const;
+    bits_t until_bits(bits_t l, bits_t r) const;
+
+    bits_t const& eval(formula f);
+    bits_t compute(formula f);
+
+    trace_t const& _trace;
+    size_t _period = 0;
+    size_t _horizon = 0;
+    size_t _back = 0;
+    size_t _words = 0;
+    std::unordered_map<formula, bits_t> _memo;
+  };
+
+  bits_t 
+  trace_checker::proposition_bits(proposition a) const {
+    black_assert(a.name().to<std::string>().has_value());
+    std::string p = *a.name().to<std::string>();
+
+    // all the states at the end of a non-looping model are
+    // full of don't cares so we return true (we may choose false as well)
+    bits_t result = constant(true);
+
+    size_t n = _trace.states.size();
+    for(size_t t = 0; t < _horizon; ++t) {
+      if(t >= n && !_period)
+        break;
+
+      size_t s = t < n ? t : _trace.loop + (t - _trace.loop) % _period;
+      state_t const& state = _trace.states[s];
+      
+      auto it = state.find(p);
+      if(it != state.end() && it->second == false)
+        set(result, t, false);
+    }
 
-    // check 'l' in all positions until 'r'
-    return check_for_all(trace, l, t, *rindex);
+    return result;
   }
 
-  static
-  bool check_since(trace_t trace, since s, size_t t) {
-    formula l = s.left();
-    formula r = s.right();
+  bits_t 
+  trace_checker::tomorrow_bits(bits_t const& op) const {
+    bits_t result(_words, 0);
+    for(size_t w = 0; w < _words; ++w) {
+      result[w] = op[w] >> 1;
+      if(w + 1 < _words)
+        result[w] |= op[w + 1] << 63;
+    }
+    set(result, _horizon - 1, get(op, _back));
+
+    return result;
+  }
+
+  bits_t 
+  trace_checker::yesterday_bits(bits_t const& op) const {
+    bits_t result(_words, 0);
+    for(size_t w = 0; w < _words; ++w) {
+      result[w] = op[w] << 1;
+      if(w > 0)
+        result[w] |= op[w - 1] >> 63;
+    }
     
-    // search for 'r'
-    std::optional<size_t> rindex = find_one_reverse(trace, r, t, 0);
+    return trim(result);
+  }
 
-    if(!rindex.has_value())
-      return false; // we didn't find 'r', the formula is false
+  // l S r holds at t iff r holds at t, or l holds at t and l S r at t - 1.
+  // This is the carry of the addition at bit t, with r as generate and l as 
+  // propagate.
+  bits_t 
+  trace_checker::since_bits(bits_t const& l, bits_t const& r) const {
+    bits_t result(_words, 0);
+    uint64_t carry = 0;
+    for(size_t w = 0; w < _words; ++w) {
+      uint64_t x = r[w];
+      uint64_t y = r[w] | l[w];
+      uint64_t carries = (x + y + carry) ^ x ^ y;
+      
+      result[w] = r[w] | (l[w] & carries);
+      carry = result[w] >> 63;
+    }
 
-    // check 'l' in all positions until 'r'
-    return check_for_all(trace, l, *rindex + 1, t + 1);
+    return trim(result);
   }
 
-  static
-  bool state_exists(trace_t trace, size_t t) {
-    return !cli::finite || t < trace.states.size();
+  // The same as the since, but propagating the carries backward, starting 
+  // from the value of the until at the successor of the last position.
+  bits_t trace_checker::until_bits(
+    bits_t const& l, bits_t const& r, bool boundary
+  ) const {
+    // the bits past the end of the trace propagate the boundary value
+    bits_t padding = constant(true);
+    for(uint64_t &w : padding)
+      w = ~w;
+
+    bits_t result(_words, 0);
+    uint64_t carry = boundary;
+    for(size_t w = _words; w > 0; --w) {
+      uint64_t g = reverse_bits(r[w - 1]);
+      uint64_t p = reverse_bits(l[w - 1] | padding[w - 1]);
+      uint64_t x = g;
+      uint64_t y = g | p;
+      uint64_t carries = (x + y + carry) ^ x ^ y;
+
+      uint64_t u = g | (p & carries);
+      result[w - 1] = reverse_bits(u);
+      carry = u >> 63;
+    }
+
+    return trim(result);
   }
 
-  struct check_lookup {
-    formula f;
-    size_t t;
+  bits_t trace_checker::until_bits(bits_t l, bits_t r) const {
+    // without a loop, the right argument must be found inside the trace
+    if(!_period) {
+      bits_t inside = prefix(_trace.states.size());
+      l = combine(std::move(l), inside, std::bit_and<>{});
+      r = combine(std::move(r), inside, std::bit_and<>{});
+      return until_bits(l, r, false);
+    }
 
-    friend bool operator==(check_lookup const&, check_lookup const&) = default;
-  };
+    // if the until holds at the successor of the last position, it is 
+    // fulfilled inside the last period, hence also when starting from the 
+    // last position with a false boundary
+    bits_t result = until_bits(l, r, false);
+    if(get(result, _back))
+      return until_bits(l, r, true);
 
-  } namespace std {
+    return result;
+  }
 
-    template<>
-    struct hash<black::frontend::check_lookup> {
-      size_t operator()(black::frontend::check_lookup l) const {
-        using namespace black_internal;
-        using namespace black;
-        size_t h1 = std::hash<formula>{}(l.f);
-        size_t h2 = std::hash<size_t>{}(l.t);
+  bits_t const& trace_checker::eval(formula f) {
+    if(auto it = _memo.find(f); it != _memo.end())
+      return it->second;
 
-        return hash_combine(h1, h2);
-      }
-    };
+    bits_t result = compute(f);
 
-  } namespace black::frontend {
+    if(cli::verbose)
+      for(size_t t = 0; t < _horizon; ++t)
+        io::println("{} at t = {} is {}", to_string(f), t, get(result, t));
 
-  static
-  bool check(trace_t trace, formula f, size_t t) 
-  {
-    static std::unordered_map<check_lookup, bool> memo;
-    if(auto it = memo.find({f, t}); it != memo.end())
-      return it->second;
+    return _memo.insert({f, std::move(result)}).first->second;
+  }
+
+  bits_t trace_checker::compute(formula f) {
+    // the finite semantics of tomorrow needs to know where the trace ends
+    auto has_next = [&]{ 
+      return prefix(cli::finite ? _trace.states.size() - 1 : _horizon);
+    };
 
-    bool result = f.match(
-      [](boolean b) {
-        return b.value();
+    return f.match(
+      [&](boolean b) {
+        return constant(b.value());
       },
       [&](proposition a) {
-        return check_proposition(trace, a, t);
+        return proposition_bits(a);
       },
-      [&](atom) -> bool { black_unreachable(); }, // LCOV_EXCL_LINE
-      [&](quantifier) -> bool { black_unreachable(); }, // LCOV_EXCL_LINE
-      [&](equality) -> bool { black_unreachable(); }, // LCOV_EXCL_LINE
-      [&](comparison) -> bool { black_unreachable(); }, // LCOV_EXCL_LINE
+      [&](atom) -> bits_t { black_unreachable(); }, // LCOV_EXCL_LINE
+      [&](quantifier) -> bits_t { black_unreachable(); }, // LCOV_EXCL_LINE
+      [&](equality) -> bits_t { black_unreachable(); }, // LCOV_EXCL_LINE
+      [&](comparison) -> bits_t { black_unreachable(); }, // LCOV_EXCL_LINE
       [&](tomorrow, formula op) {
-        return state_exists(trace, t + 1) && check(trace, op, t + 1);
+        if(!cli::finite)
+          return tomorrow_bits(eval(op));
+        return combine(tomorrow_bits(eval(op)), has_next(), std::bit_and<>{});
       },
       [&](w_tomorrow, formula op) {
-        return !state_exists(trace, t + 1) || check(trace, op, t + 1);
+        if(!cli::finite)
+          return tomorrow_bits(eval(op));
+        return combine(
+          tomorrow_bits(eval(op)), negate(has_next()), std::bit_or<>{}
+        );
       },
       [&](yesterday, formula op) {
-        return t > 0 && check(trace, op, t - 1);
+        return yesterday_bits(eval(op));
       },
       [&](w_yesterday, formula op) {
-        return t == 0 || check(trace, op, t - 1);
+        bits_t result = yesterday_bits(eval(op));
+        set(result, 0, true);
+        return result;
       },
-      [&](until u) {
-        return check_until(trace, u, t);
+      [&](until, formula l, formula r) {
+        return until_bits(eval(l), eval(r));
       },
-      [&](since s) {
-        return check_since(trace, s, t);
+      [&](since, formula l, formula r) {
+        return since_bits(eval(l), eval(r));
       },
       [&](negation, formula op) {
-        return !check(trace, op, t);
+        return negate(eval(op));
       },
       [&](conjunction, formula l, formula r) {
-        return check(trace, l, t) && check(trace, r, t);
+        return combine(eval(l), eval(r), std::bit_and<>{});
       },
       [&](disjunction, formula l, formula r) {
-        return check(trace, l, t) || check(trace, r, t);
+        return combine(eval(l), eval(r), std::bit_or<>{});
       },
       [&](implication, formula l, formula r) {
-        return !check(trace, l, t) || check(trace, r, t);
+        return combine(negate(eval(l)), eval(r), std::bit_or<>{});
       },
       [&](iff, formula l, formula r) {
-        return check(trace, l, t) == check(trace, r, t);
+        return negate(combine(eval(l), eval(r), std::bit_xor<>{}));
       },
       [&](eventually, formula op) {
-        return check(trace, U(op.sigma()->top(), op), t);
+        return until_bits(constant(true), eval(op));
       },
       [&](always, formula op) {
-        return check(trace, !F(!op), t);
+        return negate(until_bits(constant(true), negate(eval(op))));
       },
       [&](w_until, formula l, formula r) {
-        return check(trace, G(l) || U(l, r), t);
+        bits_t always = 
+          negate(until_bits(constant(true), negate(eval(l))));
+        return combine(until_bits(eval(l), eval(r)), always, std::bit_or<>{});
       },
       [&](release, formula l, formula r) {
-        return check(trace, !U(!l, !r), t);
+        return negate(until_bits(negate(eval(l)), negate(eval(r))));
       },
       [&](s_release, formula l, formula r) {
-        return check(trace, !W(!l, !r), t);
+        bits_t nl = negate(eval(l));
+        bits_t nr = negate(eval(r));
+        bits_t always = negate(until_bits(constant(true), eval(l)));
+        return negate(
+          combine(until_bits(nl, nr), always, std::bit_or<>{})
+        );
       },
       [&](once, formula op) {
-        return check(trace, S(op.sigma()->top(), op), t);
+        return since_bits(constant(true), eval(op));
       },
       [&](historically, formula op) {
-        return check(trace, !O(!op), t);
+        return negate(since_bits(constant(true), negate(eval(op))));
       },
       [&](triggered, formula l, formula r) {
-        return check(trace, !S(!l, !r), t);
+        return negate(since_bits(negate(eval(l)), negate(eval(r))));
       }
     );
-
-    if(cli::verbose)
-      io::println("{} at t = {} is {}", to_string(f), t, result);
-
-    memo.insert({{f,t}, result});
-
-    return result;
   }
 
   static
-  int check(trace_t trace, formula f) {
+  int check(trace_t const& trace, formula f) {
     size_t initial_state = 0;
     if(cli::initial_state)
       initial_state = *cli::initial_state;
 
-    bool result = check(trace, f, initial_state);
+    trace_checker checker{trace, f};
+    bool result = checker.check(f, initial_state);
     if(result)
       io::println("TRUE");
     else {
@@ -2460,25 +2460,29 @@ namespace black_internal::logic {
   }
 
   //
-  // A good application for `for_each_child`. This function tells whether a
-  // hierarchy object `h` contains any element among those given as arguments.
-  // For example, if `f` is a formula, `has_any_element_of(f,
-  // syntax_element::boolean, syntax_element::iff)` tells whether there is any
-  // boolean constant in the formula or any double implication.
+  // This function tells whether a hierarchy object `h` contains any element
+  // among those given as arguments. For example, if `f` is a formula,
+  // `has_any_element_of(f, syntax_element::boolean, syntax_element::iff)`
+  // tells whether there is any boolean constant in the formula or any double
+  // implication. The runtime fragment of each node already collects the
+  // elements of all its descendants, so this does not need to walk the
+  // formula.
   //
   template<hierarchy H, typename ...Args>
     requires (std::is_constructible_v<syntax_element, Args> && ...)
   bool has_any_element_of(H h, Args ...args) {
-    if(((h.node_type() == args) || ...))
-      return true;
-    
-    bool has = false;
-    for_each_child(h, [&](auto child) {
-      if(has_any_element_of(child, args...))
-        has = true;
-    });
+    syntax_mask_t mask{static_cast<size_t>(syntax_element{args})...};
 
-    return has;
+    return (fragment_of(h.node()) & mask) != syntax_mask_t{};
+  }
+
+  //
+  // The same as above but with the elements of a fragment, e.g.
+  // `has_any_element_of<past>(f)` tells whether `f` has any past operator.
+  //
+  template<fragment Syntax, hierarchy H>
+  bool has_any_element_of(H h) {
+    return (fragment_of(h.node()) & Syntax::mask) != syntax_mask_t{};
   }
 }
 
@@ -697,6 +697,11 @@ namespace black_internal::logic
   // declared here and implemented in `logic.cpp`, together with
   // `alphabet_impl`.
   //
+  // By default, an alphabet cannot be used concurrently from different
+  // threads. An alphabet constructed with the `alphabet_base::concurrent` tag,
+  // instead, shards its node tables and locks each shard separately, so that
+  // formulas can be created from any thread without external synchronization.
+  //
   #define declare_leaf_storage_kind(Base, Storage) \
     , public alphabet_ctor_base<syntax_element::Storage, alphabet_base>
   #define declare_leaf_hierarchy_element(Base, Storage, Element) \
@@ -708,7 +713,11 @@ namespace black_internal::logic
     template<syntax_element E>
     using base_t = alphabet_ctor_base<E, alphabet_base>;
   public:
+    struct concurrent_t { };
+    static constexpr concurrent_t concurrent{};
+
     alphabet_base();
+    explicit alphabet_base(concurrent_t);
     ~alphabet_base();
 
     alphabet_base(alphabet_base const&) = delete;
@@ -717,6 +726,9 @@ namespace black_internal::logic
     alphabet_base &operator=(alphabet_base const&) = delete;
     alphabet_base &operator=(alphabet_base &&);
 
+    // whether the alphabet has been created with the `concurrent` tag
+    bool is_concurrent() const;
+
     #define declare_leaf_storage_kind(Base, Storage) \
       template<typename ...Args> \
       class Storage Storage(Args ...args) { \
@@ -757,6 +769,7 @@ namespace black_internal::logic
 
     // pimpl pointer to `alphabet_impl`, defined in `logic.cpp`.
     std::unique_ptr<alphabet_impl> _impl;
+    bool _concurrent = false;
   };
 
   //
@@ -47,6 +47,7 @@ namespace black_internal::logic {
   {
   public:
     alphabet() = default;
+    explicit alphabet(concurrent_t c) : alphabet_base{c} { }
     alphabet(alphabet const&) = delete;
     alphabet(alphabet &&) = default;
 
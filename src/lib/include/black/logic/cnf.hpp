@@ -29,6 +29,7 @@
 
 #include <vector>
 #include <initializer_list>
+#include <span>
 #include <memory>
 
 namespace black_internal::cnf
@@ -46,24 +47,150 @@ namespace black_internal::cnf
     clause(std::initializer_list<literal> elems) : literals{elems} { }
   };
 
-  struct cnf
+  //
+  // A set of clauses, stored flat: the literals of all the clauses lie in a
+  // single array, and each clause is the span of it ending where the next
+  // one begins. Adding a clause does not allocate memory for the clause
+  // itself, and the clauses are visited as spans.
+  //
+  class cnf
   {
-    std::vector<clause> clauses;
+  public:
+    class iterator;
 
     cnf() = default;
-    cnf(std::vector<clause> _clauses) : clauses(std::move(_clauses)) { }
-    cnf(std::initializer_list<clause> elems) : clauses{elems} { }
+    cnf(std::vector<clause> const& clauses) {
+      for(clause const& c : clauses)
+        add_clause(c.literals);
+    }
+    cnf(std::initializer_list<clause> elems) {
+      for(clause const& c : elems)
+        add_clause(c.literals);
+    }
+
+    void add_clause(std::span<literal const> lits) {
+      _literals.insert(_literals.end(), lits.begin(), lits.end());
+      _ends.push_back(_literals.size());
+    }
+
+    void add_clause(std::initializer_list<literal> lits) {
+      add_clause(std::span{lits.begin(), lits.size()});
+    }
+
+    // number of clauses
+    size_t size() const { return _ends.size(); }
+
+    bool empty() const { return _ends.empty(); }
+
+    // the i-th clause
+    std::span<literal const> operator[](size_t i) const {
+      size_t begin = i == 0 ? 0 : _ends[i - 1];
+      return {_literals.data() + begin, _ends[i] - begin};
+    }
+
+    // the literals of all the clauses, one after the other
+    std::span<literal const> literals() const { return _literals; }
+
+    iterator begin() const;
+    iterator end() const;
+
+  private:
+    std::vector<literal> _literals;
+    std::vector<size_t> _ends;
+  };
+
+  class cnf::iterator 
+  {
+  public:
+    using value_type = std::span<literal const>;
+    using difference_type = ptrdiff_t;
+
+    iterator() = default;
+    iterator(cnf const *c, size_t i) : _cnf{c}, _i{i} { }
+
+    bool operator==(iterator const&) const = default;
+
+    value_type operator*() const { return (*_cnf)[_i]; }
 
+    iterator &operator++() {
+      ++_i;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator it = *this;
+      ++_i;
+      return it;
+    }
+
+  private:
+    cnf const *_cnf = nullptr;
+    size_t _i = 0;
   };
 
+  inline cnf::iterator cnf::begin() const { return iterator{this, 0}; }
+  inline cnf::iterator cnf::end() const { return iterator{this, size()}; }
+
   // Removal of booleans from a formula. Internal use, exposed here for testing.
   BLACK_EXPORT
   logic::formula<logic::propositional> 
   remove_booleans(logic::formula<logic::propositional> f);
 
+  //
+  // Kinds of CNF conversion. The `full` Tseitin conversion defines the fresh
+  // literal of each subformula in both directions. The `polarity_aware` one
+  // (Plaisted-Greenbaum) only emits the directions needed by the polarities 
+  // of the occurrences of each subformula, both of them only under double
+  // implications. The result is equisatisfiable with the formula, but the
+  // fresh literals only imply their subformulas, or are implied by them.
+  //
+  enum class tseitin_mode : uint8_t {
+    full,
+    polarity_aware
+  };
+
   // Tseitin conversion to CNF
   BLACK_EXPORT
-  cnf to_cnf(logic::formula<logic::propositional> f);
+  cnf to_cnf(
+    logic::formula<logic::propositional> f, 
+    tseitin_mode mode = tseitin_mode::full
+  );
+
+  //
+  // Incremental Tseitin conversion. The encoder remembers the subformulas
+  // already converted, so each call to `to_cnf()` only returns the
+  // definitional clauses of subformulas never seen before, plus the unit
+  // clause asserting the formula itself. Meant to be owned by a SAT solver
+  // which keeps all the clauses it is given. In polarity-aware mode, the 
+  // encoder remembers which directions of each definition were emitted, and
+  // adds the other one if a subformula later occurs with the other polarity.
+  //
+  class BLACK_EXPORT tseitin_encoder
+  {
+  public:
+    tseitin_encoder(tseitin_mode mode = tseitin_mode::full);
+    ~tseitin_encoder();
+
+    tseitin_encoder(tseitin_encoder const&) = delete;
+    tseitin_encoder &operator=(tseitin_encoder const&) = delete;
+    tseitin_encoder(tseitin_encoder &&);
+    tseitin_encoder &operator=(tseitin_encoder &&);
+
+    // Tseitin conversion of `f`, skipping already converted subformulas
+    cnf to_cnf(logic::formula<logic::propositional> f);
+
+    // Same as `to_cnf()`, but the new subformulas are not remembered, so the 
+    // caller can later retract the returned clauses without affecting 
+    // subsequent conversions
+    cnf to_transient_cnf(logic::formula<logic::propositional> f);
+
+    // forgets all the subformulas converted so far
+    void clear();
+
+  private:
+    struct _encoder_t;
+    std::unique_ptr<_encoder_t> _data;
+  };
 
   // Conversion of literals, clauses and cnfs to formulas
   BLACK_EXPORT
@@ -71,12 +198,17 @@ namespace black_internal::cnf
 
   BLACK_EXPORT
   logic::formula<logic::propositional> to_formula(
-    logic::alphabet &sigma, clause c
+    logic::alphabet &sigma, std::span<literal const> c
+  );
+
+  BLACK_EXPORT
+  logic::formula<logic::propositional> to_formula(
+    logic::alphabet &sigma, clause const& c
   );
 
   BLACK_EXPORT
   logic::formula<logic::propositional> to_formula(
-    logic::alphabet &sigma, cnf c
+    logic::alphabet &sigma, cnf const& c
   );
 }
 
@@ -85,6 +217,8 @@ namespace black {
   using black_internal::cnf::clause;
   using black_internal::cnf::cnf;
   using black_internal::cnf::to_cnf;
+  using black_internal::cnf::tseitin_mode;
+  using black_internal::cnf::tseitin_encoder;
   using black_internal::cnf::to_formula;
 }
 
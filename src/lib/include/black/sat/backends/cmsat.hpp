@@ -37,9 +37,13 @@ namespace black_internal::cmsat
     virtual tribool is_sat() override;
     virtual tribool 
       is_sat_with(std::vector<dimacs::literal> const& assumptions) override;
+    virtual bool failed(dimacs::literal l) const override;
     virtual tribool value(uint32_t v) const override;
     virtual void clear() override;
     virtual void interrupt() override;
+    virtual bool set_option(
+      std::string_view key, ::black::sat::option_value const& value
+    ) override;
     virtual std::optional<std::string> license() const override;
 
   private:
@@ -0,0 +1,69 @@
+//
+// BLACK - Bounded Ltl sAtisfiability ChecKer
+//
+// (C) 2020 Nicola Gigante
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <black/support/common.hpp>
+#include <black/sat/dimacs.hpp>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace black_internal::ipasir 
+{
+  //
+  // Backend for any SAT solver implementing the IPASIR interface, loaded at
+  // runtime from a shared library. The library is taken from the 
+  // BLACK_IPASIR_LIBRARY environment variable at startup, or from a call
+  // to `ipasir::load()`. The backend is registered with the name `ipasir` 
+  // once a library has been loaded.
+  //
+  class BLACK_EXPORT ipasir : public ::black::sat::dimacs::solver
+  {
+  public:
+    ipasir(black::logic::scope const&);
+    virtual ~ipasir() override;
+
+    // Loads the IPASIR library at `path`, used by the backends created 
+    // afterwards. Returns an error message if the library cannot be loaded.
+    static std::optional<std::string> load(std::string const& path);
+
+    virtual void new_vars(size_t n) override;
+    virtual void assert_clause(dimacs::clause f) override;
+    virtual tribool is_sat() override;
+    virtual tribool 
+      is_sat_with(std::vector<dimacs::literal> const& assumptions) override;
+    virtual bool failed(dimacs::literal l) const override;
+    virtual tribool value(uint32_t v) const override;
+    virtual void clear() override;
+    virtual void interrupt() override;
+    virtual std::optional<std::string> license() const override;
+
+  private:
+    struct _ipasir_t;
+    std::unique_ptr<_ipasir_t> _data;
+  };
+}
+
+namespace black::sat::backends {
+  using black_internal::ipasir::ipasir;
+}
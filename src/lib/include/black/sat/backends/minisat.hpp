@@ -30,7 +30,7 @@ namespace black_internal::minisat
   class BLACK_EXPORT minisat : public ::black::sat::dimacs::solver
   {
   public:
-    minisat();
+    minisat(black::logic::scope const&);
     virtual ~minisat() override;
 
     virtual void new_vars(size_t n) override;
@@ -38,8 +38,13 @@ namespace black_internal::minisat
     virtual tribool is_sat() override;
     virtual tribool 
       is_sat_with(std::vector<dimacs::literal> const& assumptions) override;
+    virtual bool failed(dimacs::literal l) const override;
     virtual tribool value(uint32_t v) const override;
     virtual void clear() override;
+    virtual void interrupt() override;
+    virtual bool set_option(
+      std::string_view key, ::black::sat::option_value const& value
+    ) override;
     virtual std::optional<std::string> license() const override;
 
   private:
@@ -38,15 +38,22 @@ namespace black_internal::z3
 
     virtual void assert_formula(formula f) override;
     virtual tribool is_sat() override;
-    virtual tribool is_sat_with(formula assumption) override;
+    virtual tribool 
+      is_sat_with(std::vector<formula> const& assumptions) override;
+    virtual std::vector<formula> failed_assumptions() const override;
     virtual tribool value(proposition a) const override;
     virtual tribool value(atom a) const override;
     virtual tribool value(equality a) const override;
     virtual tribool value(comparison a) const override;
     virtual void clear() override;
     virtual void interrupt() override;
+    virtual bool set_option(
+      std::string_view key, ::black::sat::option_value const& value
+    ) override;
     virtual std::optional<std::string> license() const override;
 
+    using ::black::sat::solver::is_sat_with;
+
   private:
     struct _z3_t;
     std::unique_ptr<_z3_t> _data;
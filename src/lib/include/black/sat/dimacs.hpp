@@ -31,7 +31,11 @@
 
 #include <istream>
 #include <string>
+#include <optional>
+#include <functional>
 #include <cstdint>
+#include <initializer_list>
+#include <span>
 
 namespace black_internal::dimacs
 {
@@ -42,9 +46,9 @@ namespace black_internal::dimacs
     uint32_t var;
   };
 
-  struct clause {
-    std::vector<literal> literals;
-  };
+  // clauses are passed to the backends as views over contiguous buffers of
+  // literals, so that asserting a clause does not need to allocate memory
+  using clause = std::span<literal const>;
 
   //
   // A specialized instance of sat::solver for backends with 
@@ -61,7 +65,12 @@ namespace black_internal::dimacs
     // sat::solver interface
     virtual void assert_formula(logic::formula<logic::FO> f) override;
     
-    virtual tribool is_sat_with(logic::formula<logic::FO> assumption) override;
+    virtual tribool is_sat_with(
+      std::vector<logic::formula<logic::FO>> const& assumptions
+    ) override;
+
+    virtual std::vector<logic::formula<logic::FO>> 
+    failed_assumptions() const override;
     
     virtual tribool value(logic::proposition a) const override;
     
@@ -70,6 +79,12 @@ namespace black_internal::dimacs
     virtual tribool value(logic::equality<logic::FO> a) const override;
     
     virtual tribool value(logic::comparison<logic::FO> a) const override;
+
+    // the variables of the step template at steps other than 0 are not
+    // reported, see for_each_template_value()
+    virtual bool for_each_value(
+      std::function<void(logic::proposition, tribool)> const& f
+    ) const override;
     
     // specialized DIMACS interface
 
@@ -79,12 +94,66 @@ namespace black_internal::dimacs
     // assert a new clause
     virtual void assert_clause(clause c) = 0;
 
+    void assert_clause(std::initializer_list<literal> c) {
+      assert_clause(clause{c.begin(), c.size()});
+    }
+
     // solve the instance
     virtual tribool is_sat() override = 0;
 
     // solve the instance assuming the given literals
     virtual tribool is_sat_with(std::vector<literal> const& assumptions) = 0;
 
+    // after is_sat_with() returned false, tells whether the assumption `l` 
+    // was needed to prove unsatisfiability. Backends that cannot tell keep
+    // the default, which conservatively answers true.
+    virtual bool failed(literal) const { return true; }
+    
+    using black::sat::solver::is_sat_with;
+
+    //
+    // Step templates. Some encodings assert the same formula at each step, 
+    // only over different propositions, like the k-unraveling of 
+    // propositional formulas. Then the formula for one step can be converted
+    // to CNF once, and its clauses copied for each new step with shifted
+    // variables. `step` tells the step of a proposition, if it has one, and
+    // `shift` moves such a proposition to another step.
+    //
+    // The propositions of `f` must be either at step 0 or 1 or come from the
+    // CNF conversion, otherwise the template is not set and false is 
+    // returned. Propositions at other steps asserted by other means share 
+    // their variables with the copies of the template.
+    //
+    using step_fn = std::function<std::optional<size_t>(proposition)>;
+    using shift_fn = std::function<proposition(proposition, size_t)>;
+
+    bool set_step_template(formula<FO> f, step_fn step, shift_fn shift);
+
+    // asserts the copy of the template going from step `k - 1` to step `k`
+    void assert_step(size_t k);
+
+    // the slot of the template holding the proposition `p` at step 0, if any
+    std::optional<uint32_t> template_slot(proposition p) const;
+
+    // the variable of the given slot of the template at step `k`
+    uint32_t template_var(uint32_t slot, size_t k);
+
+    // the propositions of the slots of the template, at step 0
+    std::span<proposition const> template_slots() const;
+
+    // calls `f(slot, k, v)` for each slot of the template and each step 
+    // `k > 0` allocated so far, where `v` is the value of the slot at step 
+    // `k`, i.e., of `shift(template_slots()[slot], k)`, which is not built.
+    // Propositions registered before setting the template keep their own 
+    // variable, reported by for_each_value() instead. Does nothing if no 
+    // template is set.
+    void for_each_template_value(
+      std::function<void(uint32_t, size_t, tribool)> const& f
+    ) const;
+
+    // allocates a new variable not associated to any proposition
+    uint32_t fresh_var();
+
     // retrieve the value of a proposition after is_sat() or is_sat_with() 
     virtual tribool value(uint32_t var) const = 0;
 
@@ -102,6 +171,17 @@ namespace black_internal::dimacs
     void clear_vars();
 
   private:
+    // asserts the given clauses, each disjoined with `guard` if given
+    void assert_cnf(cnf::cnf const& c, std::optional<literal> guard);
+
+    // records which assumptions failed in the last call to is_sat_with(). 
+    // `complex` are the non-literal assumptions, guarded by `guard`
+    void collect_failed(
+      std::vector<std::pair<formula<FO>, literal>> const& given,
+      std::vector<formula<propositional>> const& complex,
+      std::optional<literal> guard
+    );
+
     struct _solver_t;
     std::unique_ptr<_solver_t> _data;
   };
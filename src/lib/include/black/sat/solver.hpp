@@ -29,8 +29,12 @@
 #include <black/support/tribool.hpp>
 
 #include <memory>
+#include <functional>
+#include <optional>
+#include <string>
 #include <type_traits>
 #include <string_view>
+#include <variant>
 #include <vector>
 
 namespace black::sat 
@@ -40,6 +44,35 @@ namespace black::sat
     quantifiers
   };
 
+  //
+  // Value of a backend-specific tuning option, see `solver::set_option()`
+  //
+  using option_value = std::variant<bool, int64_t, double, std::string>;
+
+  //
+  // Parses the value of an option given as a string, e.g. on the command 
+  // line: `true` and `false` are booleans, then integers and floating-point 
+  // numbers are recognized, and anything else is kept as a string
+  //
+  BLACK_EXPORT option_value parse_option_value(std::string_view str);
+
+  // the textual form of an option value, for backends taking strings
+  BLACK_EXPORT std::string to_string(option_value const& value);
+
+  //
+  // Retrieves an option value as a `T`, if it has the right type. Integers
+  // are also accepted where floating-point numbers are expected.
+  //
+  template<typename T>
+  std::optional<T> option_as(option_value const& value) {
+    if(auto v = std::get_if<T>(&value); v)
+      return *v;
+    if constexpr(std::is_same_v<T, double>)
+      if(auto v = std::get_if<int64_t>(&value); v)
+        return double(*v);
+    return {};
+  }
+
   //
   // Generic interface to backend SAT solvers
   //  
@@ -70,7 +103,24 @@ namespace black::sat
     
     // tell if the current set of assertions is satisfiable, 
     // under the given assumption
-    virtual tribool is_sat_with(logic::formula<logic::FO> assumption) = 0;
+    tribool is_sat_with(logic::formula<logic::FO> assumption) {
+      return is_sat_with(std::vector<logic::formula<logic::FO>>{assumption});
+    }
+
+    // tell if the current set of assertions is satisfiable, under the given
+    // set of assumptions. The assumptions only hold for the current call, 
+    // and any auxiliary definition the backend needs to express them is 
+    // retracted before returning. Literals (propositions and negated 
+    // propositions) are passed as native assumptions to the backend.
+    virtual tribool 
+    is_sat_with(std::vector<logic::formula<logic::FO>> const& assumptions) = 0;
+
+    // after a call to is_sat_with() returned false, returns the assumptions 
+    // of that call that were needed to prove unsatisfiability. The result is
+    // a subset of the assumptions, not necessarily minimal. Backends that 
+    // cannot tell may return all the assumptions.
+    virtual std::vector<logic::formula<logic::FO>> 
+    failed_assumptions() const = 0;
     
     // gets the value of a proposition from the solver.
     // The result is tribool::undef if the variable has not been decided
@@ -96,6 +146,15 @@ namespace black::sat
     // or if it is a don't care
     virtual tribool value(logic::comparison<logic::FO> a) const = 0;
 
+    // calls `f(a, v)` for each proposition `a` known to the backend, with 
+    // its value `v` in the current model, in a single pass over the model.
+    // Returns false without calling `f` if the backend does not support 
+    // this kind of enumeration, in which case value() must be used instead.
+    virtual bool 
+    for_each_value(std::function<void(proposition, tribool)> const&) const {
+      return false;
+    }
+
     // clear the current context completely
     virtual void clear() = 0;
 
@@ -103,6 +162,14 @@ namespace black::sat
     // if supported by the backend
     virtual void interrupt() = 0;
 
+    // sets a backend-specific tuning option, returning false if the backend
+    // does not recognize `key` or if `value` is not valid for it. Options 
+    // must be set before asserting anything, and they survive clear(). 
+    // Backends have no options by default.
+    virtual bool set_option(std::string_view, option_value const&) {
+      return false;
+    }
+
     // License note for whatever third-party software lies under the hood
     virtual std::optional<std::string> license() const = 0;
   };
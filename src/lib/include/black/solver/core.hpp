@@ -33,8 +33,24 @@ namespace black_internal::core {
   
   using namespace black::logic::fragments::LTLPFO;
 
+  //
+  // Returns an unsatisfiable core of the unsatisfiable formula `f`, where 
+  // the subformulas not needed for its unsatisfiability are replaced by 
+  // placeholders (see `core_placeholder_t`). The core is unsatisfiable.
+  //
+  // Whether a subformula can be replaced is checked by refuting the 
+  // formula without it, which may take much longer than refuting the whole
+  // formula. Hence, by default, each such check is given up at a bound 
+  // proportional to the one that refutes the whole formula, and the 
+  // subformula is kept, so the core may not be minimal. If `minimal` is 
+  // true, the checks are not bounded, and no subformula of the core can be
+  // replaced (with all its occurrences) without making it satisfiable, at
+  // the price of possibly much longer runs.
+  //
   BLACK_EXPORT
-  formula unsat_core(scope const& xi, formula f, bool finite);
+  formula unsat_core(
+    scope const& xi, formula f, bool finite, bool minimal = false
+  );
 
   struct core_placeholder_t {
     size_t n;
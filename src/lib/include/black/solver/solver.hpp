@@ -27,6 +27,7 @@
 #include <black/support/common.hpp>
 #include <black/logic/logic.hpp>
 #include <black/support/tribool.hpp>
+#include <black/sat/solver.hpp>
 
 #include <vector>
 #include <variant>
@@ -42,6 +43,22 @@ namespace black_internal::solver {
 
   using namespace black::logic::fragments::LTLPFO;
 
+  //
+  // Strategies for the encoding of the LOOP_k formula, which tells whether
+  // the last state of a model of length k can loop back to a previous one.
+  //
+  enum class loop_encoding : uint8_t {
+    // the encoding of the TABLEAUX 2019 paper, which states the conditions 
+    // for each loop l < k anew at each bound k
+    pairwise,
+
+    // a linear-size encoding, where the start of the loop is chosen by a 
+    // selector literal for each state, and the values of the requests at
+    // the start of the loop are tracked by literals defined inductively, 
+    // so that each new bound only adds O(|requests|) formulas
+    compact
+  };
+
   // main solver class
   class BLACK_EXPORT solver 
   {
@@ -72,6 +89,9 @@ namespace black_internal::solver {
       // If `finite` is `true` the formula is solved for the finite-trace
       // semantics.
       //
+      // If `timeout` is given, the call is interrupted when it expires, 
+      // returning `tribool::undef`. 
+      //
       // WARNING: `semi_decision = false` with first-order formulas using
       //          next(x) terms results in an *incomplete* algorithm.
       tribool solve(
@@ -79,7 +99,7 @@ namespace black_internal::solver {
         formula f,
         bool finite = false,
         size_t k_max = std::numeric_limits<size_t>::max(),
-        std::optional<std::chrono::seconds> timeout = {},
+        std::optional<std::chrono::milliseconds> timeout = {},
         bool semi_decision = false
       );
       
@@ -91,7 +111,7 @@ namespace black_internal::solver {
         formula f,
         bool finite = false,
         size_t k_max = std::numeric_limits<size_t>::max(),
-        std::optional<std::chrono::seconds> timeout = {},
+        std::optional<std::chrono::milliseconds> timeout = {},
         bool semi_decision = false
       );
 
@@ -107,12 +127,57 @@ namespace black_internal::solver {
       // does not make sense before the first call to solve()
       size_t last_bound() const;
 
+      // Returns the number of X/Y/Z-requests and lookaheads occurring more 
+      // than once in the formula of the last call to solve(), which are 
+      // encoded only once
+      size_t last_duplicate_requests() const;
+
+      // Whether the last call to solve() gave the encoding directly as 
+      // clauses to the SAT backend that provided the answer, which happens
+      // for propositional formulas over DIMACS backends when not tracing
+      bool last_direct_encoding() const;
+
       // Choose the SAT backend. The backend must exist.
       void set_sat_backend(std::string name);
 
       // Retrieve the current SAT backend
       std::string sat_backend() const;
 
+      // Choose a portfolio of SAT backends. solve() and is_valid() run the
+      // algorithm on all of them in parallel, on separate threads. The first
+      // definitive answer wins and the other runs are interrupted. 
+      // The backends must exist. An empty portfolio (the default) means 
+      // only the backend chosen with set_sat_backend() is used.
+      // If the formula comes from a concurrent alphabet (see 
+      // `alphabet::concurrent`), the runs encode the formula in parallel,
+      // otherwise they take turns in using the alphabet.
+      void set_portfolio(std::vector<std::string> backends);
+
+      // Retrieve the current portfolio
+      std::vector<std::string> portfolio() const;
+
+      // Choose the encoding of LOOP_k (`loop_encoding::pairwise` by default)
+      void set_loop_encoding(loop_encoding encoding);
+
+      // Set a tuning option of the SAT backends (see 
+      // `sat::solver::set_option()`), passed to the backends created by the
+      // following calls to solve() and is_valid(). Each backend ignores the 
+      // options it does not recognize, so that a portfolio can mix options
+      // for different backends, but each option must be accepted by at least
+      // one of them. Returns false, without setting the option, if none of
+      // the backends currently chosen accepts it. If the backends are 
+      // changed afterwards, solve() and is_valid() return tribool::undef 
+      // without solving when an option is accepted by none of them.
+      bool 
+      set_backend_option(std::string key, black::sat::option_value value);
+
+      // Forget all the options given with set_backend_option()
+      void clear_backend_options();
+
+      // The SAT backend that provided the answer of the last call to solve()
+      // or is_valid(), which is sat_backend() if no portfolio is set
+      std::string last_sat_backend() const;
+
       // Data type sent to the debug trace routine
       struct trace_t {
         enum type_t {
@@ -145,12 +210,32 @@ namespace black_internal::solver {
   class BLACK_EXPORT model
   {
     public:
+      // The values of a set of propositions at all the time steps of the 
+      // model, as a dense matrix with a row for each time step
+      struct trace {
+        std::vector<proposition> props;
+        size_t size = 0;
+        size_t loop = 0;
+        std::vector<tribool> values;
+
+        // value of `props[i]` at time `t`
+        tribool value(size_t i, size_t t) const {
+          return values[t * props.size() + i];
+        }
+      };
+
       size_t size() const;
       size_t loop() const;
       tribool value(proposition a, size_t t) const;
       tribool value(atom a, size_t t) const;
       tribool value(equality a, size_t t) const;
       tribool value(comparison a, size_t t) const;
+
+      // Extracts the values of the given propositions at all the time steps
+      // at once. This is much faster than calling value() for each
+      // proposition and time step, which has to build the stepped version of
+      // each proposition.
+      trace values(std::vector<proposition> const& props) const;
     private:
       friend class solver;
       model(solver const&s) : _solver{s} { }
@@ -164,6 +249,7 @@ namespace black_internal::solver {
 namespace black {
   using black_internal::solver::solver;
   using black_internal::solver::model;
+  using black_internal::solver::loop_encoding;
 }
 
 #endif // SOLVER_HPP
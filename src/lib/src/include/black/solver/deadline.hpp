@@ -0,0 +1,97 @@
+//
+// BLACK - Bounded Ltl sAtisfiability ChecKer
+//
+// (C) 2019 Luca Geatti
+// (C) 2019 Nicola Gigante
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef BLACK_SOLVER_DEADLINE_HPP
+#define BLACK_SOLVER_DEADLINE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace black_internal::solver {
+
+  //
+  // Process-wide scheduler of deadlines, used to implement the timeouts of
+  // `black::solver`. A single timer thread, started on first use, keeps the
+  // pending deadlines in a heap and calls the corresponding callbacks when
+  // they expire. Callbacks run on the timer thread, so they must be short.
+  //
+  class deadline_service
+  {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    //
+    // A registered deadline. Destroying the ticket (or calling `cancel()`)
+    // cancels the deadline. When `cancel()` returns, the callback is
+    // guaranteed not to be running and not to be called anymore.
+    //
+    class ticket
+    {
+    public:
+      ticket() = default;
+      ticket(ticket const&) = delete;
+      ticket(ticket &&other) : _id{other._id} { other._id = 0; }
+      ~ticket() { cancel(); }
+
+      ticket &operator=(ticket const&) = delete;
+      ticket &operator=(ticket &&other) {
+        if(this != &other) {
+          cancel();
+          _id = other._id;
+          other._id = 0;
+        }
+        return *this;
+      }
+
+      void cancel();
+
+    private:
+      friend class deadline_service;
+      explicit ticket(uint64_t id) : _id{id} { }
+
+      uint64_t _id = 0;
+    };
+
+    // the process-wide instance
+    static deadline_service &instance();
+
+    // calls `callback` on the timer thread when `deadline` expires
+    ticket schedule(clock::time_point deadline, std::function<void()> callback);
+
+    deadline_service(deadline_service const&) = delete;
+    deadline_service &operator=(deadline_service const&) = delete;
+
+  private:
+    deadline_service();
+    ~deadline_service();
+
+    struct _service_t;
+    std::unique_ptr<_service_t> _data;
+  };
+
+}
+
+#endif // BLACK_SOLVER_DEADLINE_HPP
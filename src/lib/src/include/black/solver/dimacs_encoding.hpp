@@ -0,0 +1,129 @@
+//
+// BLACK - Bounded Ltl sAtisfiability ChecKer
+//
+// (C) 2019 Luca Geatti
+// (C) 2019 Nicola Gigante
+// (C) 2020 Gabriele Venturato
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef BLACK_SOLVER_DIMACS_ENCODING_HPP
+#define BLACK_SOLVER_DIMACS_ENCODING_HPP
+
+#include <black/solver/encoding.hpp>
+#include <black/sat/dimacs.hpp>
+
+#include <optional>
+#include <vector>
+
+namespace black_internal::encoder {
+
+  //
+  // Encoding of propositional LTL/LTLP formulas emitted directly as clauses
+  // over the variables of a DIMACS backend. The k-unravelings are copies of
+  // a step template (see `dimacs::solver::set_step_template()`), and the
+  // EMPTY, LOOP and PRUNE encodings for k > 0 are built straight from the 
+  // requests of the encoder, without building any formula.
+  //
+  // The template also names, at each step, the eventualities and the targets
+  // of past requests, so that their variables can be used here.
+  //
+  struct dimacs_encoder
+  {
+    // Sets up the step template on `sat`. Returns an empty optional if the
+    // formula of `enc` is not propositional or the template is not accepted.
+    // Before k = 1, the formulas from `enc` must be asserted instead.
+    static std::optional<dimacs_encoder> make(
+      encoder &enc, black::sat::dimacs::solver &sat
+    );
+
+    // Asserts the k-unraveling, for k > 0
+    void assert_k_unraveling(size_t k);
+
+    // Tests satisfiability assuming EMPTY_k or LOOP_k, for k > 0. 
+    tribool is_sat_with_empty_or_loop(size_t k);
+
+    // Asserts the negation of PRUNE_k, for k > 0
+    void assert_not_prune(size_t k);
+
+    // The loop of the model found by the last call to 
+    // `is_sat_with_empty_or_loop()`, if any
+    std::optional<size_t> loop() const;
+
+  private:
+    dimacs_encoder(encoder &enc, black::sat::dimacs::solver &sat)
+      : _enc{&enc}, _sat{&sat} { }
+
+    // the name of the value of `f` at step k
+    static proposition stepped(formula<LTLPFO> f, size_t k);
+
+    using literal = black::sat::dimacs::literal;
+
+    literal ground(size_t req, size_t k);
+    literal ev(size_t req, size_t k);
+    literal target(size_t req, size_t k);
+    literal eq(size_t l, size_t k);
+    literal seen(size_t req, size_t i, size_t k);
+    literal fresh();
+
+    // defines the literals of the compact LOOP encoding new at bound k, and
+    // returns a literal implying LOOP_k (see `encoder::loop_axioms()`)
+    literal compact_loop(size_t k);
+
+    encoder *_enc;
+    black::sat::dimacs::solver *_sat;
+
+    // slots of the template for the requests, their eventualities, if any, 
+    // and their targets, if past requests
+    std::vector<uint32_t> _grounds;
+    std::vector<std::optional<uint32_t>> _evs;
+    std::vector<std::optional<uint32_t>> _targets;
+    uint32_t _not_last = 0;
+
+    // _eqs[k][l] is the variable telling whether steps l and k agree on all 
+    // the requests, for l < k
+    std::vector<std::vector<uint32_t>> _eqs;
+
+    // _seens[req][k][i - 1] is the variable telling whether the eventuality 
+    // of `req` is fulfilled somewhere between steps i and k, for 0 < i <= k
+    std::vector<std::vector<std::vector<uint32_t>>> _seens;
+
+    // variables telling whether the last state loops to each of the states 
+    // before it, for the last call to `is_sat_with_empty_or_loop()`
+    std::vector<uint32_t> _loops;
+
+    // for the compact LOOP encoding, the selectors of the start of the loop,
+    // the variable telling whether the loop starts before the last step, and
+    // the last variables tracking, for each request, its value at the start 
+    // of the loop, its value at the step after it (for past requests) and
+    // whether its eventuality has been fulfilled since then (if any)
+    std::vector<uint32_t> _starts;
+    uint32_t _started = 0;
+    std::vector<uint32_t> _loop_states;
+    std::vector<uint32_t> _loop_next_states;
+    std::vector<uint32_t> _loop_seens;
+
+    // the variable implying the compact LOOP_k in the last call to 
+    // `is_sat_with_empty_or_loop()`, if any
+    std::optional<uint32_t> _loop_found;
+  };
+
+}
+
+#endif // BLACK_SOLVER_DIMACS_ENCODING_HPP
@@ -28,14 +28,19 @@
 
 #include <black/logic/logic.hpp>
 #include <black/logic/prettyprint.hpp>
+#include <black/solver/solver.hpp>
 
+#include <optional>
+#include <string_view>
 #include <vector>
 
 #include <tsl/hopscotch_map.h>
+#include <tsl/hopscotch_set.h>
 
 namespace black_internal::encoder {
   
   using namespace black_internal::logic;
+  using black_internal::solver::loop_encoding;
 
   struct req_t {
     enum type_t : uint8_t {
@@ -78,16 +83,95 @@ namespace black_internal::encoder {
     req_t::strength_t strength;
   };
 
+  // key of the cache of `encoder::to_ground_snf()`: a formula and the 
+  // index of its environment
+  struct snf_key_t {
+    bool operator==(snf_key_t const&) const = default;
+
+    formula<LTLPFO> f;
+    size_t env;
+  };
+
+  struct env_hash_t {
+    size_t operator()(std::vector<var_decl> const& env) const {
+      size_t h = 0;
+      for(auto d : env)
+        h = hash_combine(h, d.hash());
+      return h;
+    }
+  };
+
+}
+
+namespace std {
+  template<>
+  struct hash<black_internal::encoder::req_t> {
+    size_t operator()(black_internal::encoder::req_t r) const {
+      using black_internal::encoder::req_t;
+      using namespace black_internal;
+      
+      size_t h = std::hash<logic::formula<logic::LTLPFO>>{}(r.target);
+      h = hash_combine(h, std::hash<req_t::type_t>{}(r.type));
+      h = hash_combine(h, std::hash<req_t::strength_t>{}(r.strength));
+      
+      for(auto d : r.signature)
+        h = hash_combine(h, d.hash());
+      
+      return h;
+    }
+  };
+
+  template<>
+  struct hash<black_internal::encoder::snf_key_t> {
+    size_t operator()(black_internal::encoder::snf_key_t key) const {
+      using namespace black_internal;
+      
+      return hash_combine(
+        std::hash<logic::formula<logic::LTLPFO>>{}(key.f), key.env
+      );
+    }
+  };
+
+  template<>
+  struct hash<black_internal::encoder::lookahead_t> {
+    size_t operator()(black_internal::encoder::lookahead_t lh) const {
+      using black_internal::encoder::req_t;
+      using namespace black_internal;
+      
+      size_t h = std::hash<logic::variable>{}(lh.target);
+      h = hash_combine(h, std::hash<req_t::type_t>{}(lh.type));
+      h = hash_combine(h, std::hash<req_t::strength_t>{}(lh.strength));
+      
+      return h;
+    }
+  };
+}
+
+namespace black_internal::encoder {
+
+  struct dimacs_encoder;
+
   //
   // Functions that implement the SAT encoding. 
   // Refer to the TABLEAUX 2019 and TIME 2021 papers for details.
   //
   struct encoder 
   {
-    encoder(formula<LTLPFO> f, scope &xi, bool finite) 
-      : _frm{f}, _sigma{_frm.sigma()}, 
+    //
+    // If `guards` are given, the parts of the formula in the scope of a 
+    // conjunct `a` (or of a disjunct `!a` in NNF), for `a` in `guards`, are
+    // disabled when `a` is false at step 0: the LOOP and PRUNE conditions on
+    // the requests occurring only in disabled parts then hold trivially. 
+    // This is only correct if each guard has the same value at all steps, 
+    // as in `core::unsat_core()`, where guards are set by assumptions.
+    //
+    encoder(
+      formula<LTLPFO> f, scope &xi, bool finite, 
+      loop_encoding loops = loop_encoding::pairwise,
+      std::vector<proposition> const& guards = {}
+    ) : _frm{f}, _sigma{_frm.sigma()}, 
         _global_xi{&xi}, _xi{chain(xi)}, 
-        _finite{finite}
+        _finite{finite}, _loops{loops}, _guards(guards.begin(), guards.end())
     {
       _frm = to_nnf(_frm);
       _collect_requests(_frm);
@@ -101,12 +185,36 @@ namespace black_internal::encoder {
 
     formula<LTLPFO> get_formula() const { return _frm; }
 
+    loop_encoding get_loop_encoding() const { return _loops; }
+
+    // The number of requests and lookaheads occurring more than once in the
+    // formula, which are only encoded once
+    size_t duplicates() const { return _duplicates; }
+
     // Return the loop var for the loop from l to k
     static proposition loop_prop(alphabet *sigma, size_t l, size_t k);
 
+    // Return the var telling whether the loop starts at step l
+    // (compact encoding only)
+    static proposition loop_start_prop(alphabet *sigma, size_t l);
+
+    // Return the var telling whether LOOP_k holds (compact encoding only)
+    static proposition loop_found_prop(alphabet *sigma, size_t k);
+
+    // Return the var assumed to look for EMPTY_k || LOOP_k, which is only
+    // implied by it
+    static proposition empty_or_loop_prop(alphabet *sigma, size_t k);
+
     // Make the stepped ground version of a proposition
     static proposition stepped(proposition p, size_t k);
 
+    // The step of a stepped proposition or of the ground version of a 
+    // request, if `p` is one of them
+    static std::optional<size_t> step_of(proposition p);
+
+    // Moves a proposition recognized by `step_of()` to step `k`
+    static proposition at_step(proposition p, size_t k);
+
     // Make the stepped version of a term, t_G^k
     term<FO> stepped(term<LTLPFO> t, size_t k);
 
@@ -137,12 +245,18 @@ namespace black_internal::encoder {
 
     // Put a formula in Stepped Normal Form
     formula<FO> to_ground_snf(
-      formula<LTLPFO> f, size_t k, std::vector<var_decl> env
+      formula<LTLPFO> f, size_t k, std::vector<var_decl> const& env
     );
 
     // Generates the PRUNE encoding
     formula<FO> prune(size_t k);
 
+    // Generates the definitions of the auxiliary literals new at bound k
+    formula<FO> prune_axioms(size_t k);
+
+    // Generates the definitions of the `seen` literals new at bound k
+    formula<FO> seen_axioms(size_t k);
+
     // Generates the _lPRUNE_j^k encoding
     formula<FO> l_j_k_prune(size_t l, size_t j, size_t k);
 
@@ -152,6 +266,11 @@ namespace black_internal::encoder {
     // Generates the encoding for LOOP_k
     formula<FO> k_loop(size_t k);
 
+    // Generates the definitions of the auxiliary literals used by LOOP_k 
+    // that are new at bound k, to be asserted together with the 
+    // k-unraveling (the `seen` literals for the pairwise encoding)
+    formula<FO> loop_axioms(size_t k);
+
     // Generates the encoding for _lP_k
     formula<FO> l_to_k_period(size_t l, size_t k);
 
@@ -162,6 +281,8 @@ namespace black_internal::encoder {
     formula<FO> k_unraveling(size_t k);
 
   private:
+    friend struct dimacs_encoder;
+
     // the formula to encode
     formula<LTLPFO> _frm;
 
@@ -176,21 +297,67 @@ namespace black_internal::encoder {
     // encode for finite models
     bool _finite = false;
 
-    // X/Y/Z-requests from the formula's closure
+    // the encoding of LOOP_k
+    loop_encoding _loops = loop_encoding::pairwise;
+
+    // X/Y/Z-requests from the formula's closure, in order of discovery, 
+    // and the set of them, to skip those already found
     std::vector<req_t> _requests;
+    tsl::hopscotch_set<req_t> _requests_set;
 
-    // state variables for lookaheads
+    // state variables for lookaheads, as above
     std::vector<lookahead_t> _lookaheads;
+    tsl::hopscotch_set<lookahead_t> _lookaheads_set;
+
+    // the number of requests and lookaheads found more than once
+    size_t _duplicates = 0;
+
+    // the guards given to the constructor and, for each request, the 
+    // condition under which it occurs in an enabled part of the formula
+    tsl::hopscotch_set<proposition> _guards;
+    tsl::hopscotch_map<req_t, formula<FO>> _relevance;
 
     // cache to memoize to_nnf() calls
     tsl::hopscotch_map<formula<LTLPFO>, formula<LTLPFO>> _nnf_cache;
 
+    // cache to memoize to_ground_snf() calls, with a map for each step, 
+    // and the indexes of the environments used as keys
+    std::vector<tsl::hopscotch_map<snf_key_t, formula<FO>>> _snf_cache;
+    tsl::hopscotch_map<std::vector<var_decl>, size_t, env_hash_t> _envs;
+
     proposition not_last_prop(size_t);
     proposition not_first_prop(size_t);
     variable ground(lookahead_t lh, size_t k);
     formula<FO> ground(req_t, size_t);
+
+    // literal telling whether states l and k agree on all the requests
+    proposition eq_prop(size_t l, size_t k);
+
+    // literal telling whether the eventuality of `req` is fulfilled 
+    // somewhere between steps i and j (inclusive)
+    formula<FO> seen(req_t req, size_t i, size_t j);
+
+    // literals of the compact LOOP encoding telling whether the loop starts
+    // at or before step l, and, for a loop starting at l <= k, the value of 
+    // `req` at step l (kind "_loop_state"), at step l + 1 (kind 
+    // "_loop_next_state") and whether its eventuality is fulfilled between 
+    // steps l + 1 and k (kind "_loop_seen")
+    proposition loop_started_prop(size_t l);
+    formula<FO> loop_literal(std::string_view kind, req_t req, size_t k);
     formula<FO> forall(std::vector<var_decl> env, formula<FO> f);
 
+    // NNF of `f`, given those of its operands in `_nnf_cache`
+    formula<LTLPFO> _to_nnf(formula<LTLPFO> f);
+
+    // SNF of `f`, not cached
+    formula<FO> _to_ground_snf(
+      formula<LTLPFO> f, size_t k, std::vector<var_decl> env
+    );
+
+    // the LOOP or PRUNE condition `f` on `req`, made trivial if `req` is 
+    // disabled by the guards
+    formula<FO> guarded(req_t req, formula<FO> f);
+
     void _collect_requests(formula<LTLPFO> f, std::vector<var_decl> env = {});
     void _collect_lookaheads(term<LTLPFO> t);
     req_t mk_req(tomorrow<LTLPFO>, std::vector<var_decl>);
@@ -213,23 +380,4 @@ namespace black_internal::encoder {
 
 }
 
-namespace std {
-  template<>
-  struct hash<black_internal::encoder::req_t> {
-    size_t operator()(black_internal::encoder::req_t r) const {
-      using black_internal::encoder::req_t;
-      using namespace black_internal;
-      
-      size_t h = std::hash<logic::formula<logic::LTLPFO>>{}(r.target);
-      h = hash_combine(h, std::hash<req_t::type_t>{}(r.type));
-      h = hash_combine(h, std::hash<req_t::strength_t>{}(r.strength));
-      
-      for(auto d : r.signature)
-        h = hash_combine(h, d.hash());
-      
-      return h;
-    }
-  };
-}
-
 #endif
@@ -24,8 +24,12 @@
 #include <black/logic/cnf.hpp>
 #include <black/logic/prettyprint.hpp>
 
+#include <tsl/hopscotch_map.h>
 #include <tsl/hopscotch_set.h>
 
+#include <algorithm>
+#include <optional>
+
 namespace black_internal::cnf
 { 
   using namespace black::logic::fragments::propositional;
@@ -117,26 +121,125 @@ namespace black_internal::cnf
     return sigma.boolean(bl->value() == br->value());
   }
 
+  //
+  // The formula is simplified bottom-up, each distinct subformula only once,
+  // with an explicit stack so that long chains of operators do not exhaust 
+  // the call stack.
+  //
   formula remove_booleans(formula f) {
-    return f.match( // LCOV_EXCL_LINE
-      [](boolean b)     -> formula { return b; },
-      [](proposition p) -> formula { return p; },
-      [](auto op, auto ...args) -> formula {
-        return remove_booleans(op, remove_booleans(args)...);
-      }
-    ).match(
-      [](boolean b)     -> formula { return b; },
-      [](proposition p) -> formula { return p; },
-      [](auto op, auto ...args) -> formula {
-        return remove_booleans(op, args...);
+    tsl::hopscotch_map<formula, formula> memo;
+    std::vector<formula> stack = {f};
+
+    while(!stack.empty()) {
+      formula g = stack.back();
+      if(memo.find(g) != memo.end()) {
+        stack.pop_back();
+        continue;
       }
-    );
+
+      // the operands not simplified yet go first
+      bool ready = true;
+      g.match(
+        [](boolean) { },
+        [](proposition) { },
+        [&](auto, auto ...args) {
+          for(formula arg : {formula{args}...})
+            if(memo.find(arg) == memo.end()) {
+              stack.push_back(arg);
+              ready = false;
+            }
+        }
+      );
+      if(!ready)
+        continue;
+      
+      stack.pop_back();
+      formula simple = g.match( // LCOV_EXCL_LINE
+        [](boolean b)     -> formula { return b; },
+        [](proposition p) -> formula { return p; },
+        [&](auto op, auto ...args) -> formula {
+          return remove_booleans(op, memo.at(args)...);
+        }
+      ).match(
+        [](boolean b)     -> formula { return b; },
+        [](proposition p) -> formula { return p; },
+        [](auto op, auto ...args) -> formula {
+          return remove_booleans(op, args...);
+        }
+      );
+      memo.insert({g, simple});
+    }
+
+    return memo.at(f);
   }
 
+  //
+  // Polarities of the occurrences of a subformula, as a bit mask. The
+  // positive direction of a definition is the one where the fresh literal 
+  // implies the subformula, needed by its positive occurrences, and the 
+  // negative one is the converse.
+  //
+  enum polarity_t : uint8_t {
+    positive = 1,
+    negative = 2,
+    both = positive | negative
+  };
+
+  static polarity_t flip(polarity_t p) {
+    return polarity_t(((p & positive) << 1) | ((p & negative) >> 1));
+  }
+
+  //
+  // Directions of the definitions already emitted by tseitin() for each
+  // subformula. Directions found in `frozen`, if given, count as already 
+  // emitted, but new ones are only recorded in `seen`.
+  //
+  struct tseitin_memo {
+    tsl::hopscotch_map<formula, polarity_t> &seen;
+    tsl::hopscotch_map<formula, polarity_t> const *frozen = nullptr;
+
+    // returns the directions among `p` not yet emitted for `f`, 
+    // recording them as emitted
+    polarity_t insert(formula f, polarity_t p) {
+      uint8_t done = 0;
+      if(frozen)
+        if(auto it = frozen->find(f); it != frozen->end())
+          done = it->second;
+      
+      polarity_t &emitted = seen[f];
+      done |= emitted;
+
+      polarity_t missing = polarity_t(p & ~done);
+      emitted = polarity_t(emitted | missing);
+      
+      return missing;
+    }
+
+    // tells whether all the directions in `p` were already emitted for `f`
+    bool converted(formula f, polarity_t p) const {
+      uint8_t done = 0;
+      if(frozen)
+        if(auto it = frozen->find(f); it != frozen->end())
+          done = it->second;
+      if(auto it = seen.find(f); it != seen.end())
+        done |= it->second;
+      
+      return (p & ~done) == 0;
+    }
+  };
+
   static void tseitin(
     formula f, 
-    std::vector<clause> &clauses, 
-    tsl::hopscotch_set<formula> &memo
+    cnf &clauses, 
+    tseitin_memo &memo,
+    polarity_t polarity
+  );
+
+  static void assert_root(
+    formula f, 
+    cnf &clauses, 
+    tseitin_memo &memo,
+    polarity_t polarity
   );
 
   // TODO: disambiguate fresh propositions
@@ -146,181 +249,466 @@ namespace black_internal::cnf
     return f.sigma()->proposition(f);
   }
 
-  cnf to_cnf(formula f) {
-    std::vector<clause> result;
-    tsl::hopscotch_set<formula> memo;
-    
+  // the literal standing for `f` in the clauses. Negated propositions are
+  // negative literals, so they need no definition
+  static literal lit(formula f) {
+    if(auto n = f.to<negation>(); n)
+      if(auto p = n->argument().to<proposition>(); p)
+        return {false, *p};
+    return {true, fresh(f)};
+  }
+
+  static literal negated(literal l) {
+    return {!l.sign, l.prop};
+  }
+
+  //
+  // Collects the operands of the maximal chains of `Op` nodes (conjunctions 
+  // or disjunctions) rooted at `roots`, so that the chain is encoded as a 
+  // single n-ary gate. The chain stops at the nodes whose definition with 
+  // polarity `p` was already emitted, whose literals can be used instead.
+  // Chains may share nodes, so each node is visited only once, and repeated 
+  // operands are dropped, since conjunctions and disjunctions are 
+  // idempotent.
+  //
+  template<typename Op>
+  static void operands(
+    std::initializer_list<formula> roots, polarity_t p, 
+    tseitin_memo const& memo, std::vector<formula> &ops
+  ) {
+    tsl::hopscotch_set<formula> seen;
+
+    // chains are usually left-deep, hence the explicit stack
+    std::vector<formula> stack(std::rbegin(roots), std::rend(roots));
+    while(!stack.empty()) {
+      formula g = stack.back();
+      stack.pop_back();
+
+      if(!seen.insert(g).second)
+        continue;
+
+      auto op = g.to<Op>();
+      if(!op || memo.converted(g, p)) {
+        ops.push_back(g);
+        continue;
+      }
+      
+      stack.push_back(op->right());
+      stack.push_back(op->left());
+    }
+  }
+
+  static cnf to_cnf(formula f, tseitin_memo memo, tseitin_mode mode) {
+    cnf result;
+
     formula simple = remove_booleans(f);
     black_assert( // LCOV_EXCL_LINE 
       simple.is<boolean>() || 
       !has_any_element_of(simple, syntax_element::boolean)
     ); // LCOV_EXCL_LINE
 
-    tseitin(simple, result, memo);
     if(auto b = simple.to<boolean>(); b) {
-      if(b->value())
-        return result;
-      else {
-        result.push_back({});
-        return result;
-      }
+      if(!b->value())
+        result.add_clause({});
+      return result;
     }
 
-    result.push_back({{true, fresh(simple)}});
+    // the formula is asserted, so only its positive direction is needed.
+    // In full mode, both directions of all the definitions follow from 
+    // asking for both at the top.
+    polarity_t polarity = 
+      mode == tseitin_mode::polarity_aware ? positive : both;
+
+    assert_root(simple, result, memo, polarity);
 
-    return {result};
+    return result;
   }
 
-  static void tseitin(
+  cnf to_cnf(formula f, tseitin_mode mode) {
+    tsl::hopscotch_map<formula, polarity_t> memo;
+    return to_cnf(f, tseitin_memo{memo}, mode);
+  }
+
+  struct tseitin_encoder::_encoder_t {
+    tseitin_mode mode;
+    tsl::hopscotch_map<formula, polarity_t> memo;
+  };
+
+  tseitin_encoder::tseitin_encoder(tseitin_mode mode) 
+    : _data{std::make_unique<_encoder_t>(mode)} { }
+
+  tseitin_encoder::~tseitin_encoder() = default;
+
+  tseitin_encoder::tseitin_encoder(tseitin_encoder &&) = default;
+  
+  tseitin_encoder &tseitin_encoder::operator=(tseitin_encoder &&) = default;
+
+  cnf tseitin_encoder::to_cnf(formula f) {
+    return black_internal::cnf::to_cnf(
+      f, tseitin_memo{_data->memo}, _data->mode
+    );
+  }
+
+  cnf tseitin_encoder::to_transient_cnf(formula f) {
+    tsl::hopscotch_map<formula, polarity_t> transient;
+    return black_internal::cnf::to_cnf(
+      f, tseitin_memo{transient, &_data->memo}, _data->mode
+    );
+  }
+
+  void tseitin_encoder::clear() {
+    _data->memo.clear();
+  }
+
+  //
+  // The top-level conjunctions are split into separate assertions, and the
+  // top-level disjunctions become single clauses, so neither needs a fresh
+  // literal.
+  //
+  static void assert_root(
     formula f, 
-    std::vector<clause> &clauses, 
-    tsl::hopscotch_set<formula> &memo
+    cnf &clauses, 
+    tseitin_memo &memo,
+    polarity_t polarity
   ) {
-    if(memo.find(f) != memo.end())
+    if(f.is<conjunction>()) {
+      std::vector<formula> ops;
+      operands<conjunction>({f}, polarity, memo, ops);
+      
+      // unless `f` itself was already converted
+      if(ops.size() > 1) {
+        for(formula op : ops)
+          assert_root(op, clauses, memo, polarity);
+        return;
+      }
+    }
+
+    // the clause (l1 ∨ ... ∨ ln)
+    if(f.is<disjunction>()) {
+      std::vector<formula> ops;
+      operands<disjunction>({f}, polarity, memo, ops);
+
+      std::vector<literal> cl;
+      for(formula op : ops) {
+        tseitin(op, clauses, memo, polarity);
+        cl.push_back(lit(op));
+      }
+      clauses.add_clause(cl);
       return;
+    }
+
+    if(auto n = f.to<negation>(); n) {
+      formula arg = n->argument();
+
+      // the clause (!l1 ∨ ... ∨ !ln)
+      if(arg.is<conjunction>()) {
+        std::vector<formula> ops;
+        operands<conjunction>({arg}, flip(polarity), memo, ops);
+
+        std::vector<literal> cl;
+        for(formula op : ops) {
+          tseitin(op, clauses, memo, flip(polarity));
+          cl.push_back(negated(lit(op)));
+        }
+        clauses.add_clause(cl);
+        return;
+      }
+
+      // the unit clauses !l1, ..., !ln
+      if(arg.is<disjunction>()) {
+        std::vector<formula> ops;
+        operands<disjunction>({arg}, flip(polarity), memo, ops);
+
+        for(formula op : ops) {
+          tseitin(op, clauses, memo, flip(polarity));
+          clauses.add_clause({negated(lit(op))});
+        }
+        return;
+      }
+    }
+
+    tseitin(f, clauses, memo, polarity);
+    clauses.add_clause({lit(f)});
+  }
+
+  //
+  // A subformula to convert with the given polarity. Once its operands are
+  // pushed to the stack of operands, `ops` tells where they begin, and the
+  // definition is emitted after the operands are converted.
+  //
+  struct tseitin_frame_t {
+    formula f;
+    polarity_t polarity;
+    std::optional<size_t> ops;
+  };
+
+  //
+  // Pushes the operands of `f` whose literals appear in the definition of 
+  // `f` with polarity `todo`, both to `ops` and to `frames`, with the 
+  // polarities they have in the emitted directions. Chains of conjunctions
+  // and disjunctions are encoded as n-ary gates, so their operands are 
+  // those of the whole chain.
+  //
+  static void expand(
+    formula f, polarity_t todo, tseitin_memo const& memo, 
+    std::vector<formula> &ops, std::vector<tseitin_frame_t> &frames
+  ) {
+    size_t first = ops.size();
+    auto push = [&](formula op, polarity_t p) {
+      ops.push_back(op);
+      frames.push_back({op, p, {}});
+    };
+    auto push_chain = [&]<typename Op>(Op op, polarity_t p) {
+      operands<Op>({op.left(), op.right()}, p, memo, ops);
+      for(size_t i = first; i < ops.size(); ++i)
+        frames.push_back({ops[i], p, {}});
+    };
 
-    memo.insert(f);
     f.match(
       [](boolean)     { }, // LCOV_EXCL_LINE
       [](proposition) { },
-      [&](conjunction, auto l, auto r) 
-      {
-        tseitin(l, clauses, memo);
-        tseitin(r, clauses, memo);
+      [&](conjunction c) { push_chain(c, todo); },
+      [&](disjunction d) { push_chain(d, todo); },
+      [&](implication, auto l, auto r) {
+        push(l, flip(todo));
+        push(r, todo);
+      },
+      [&](iff, auto l, auto r) {
+        push(l, both);
+        push(r, both);
+      },
+      [&](negation, auto arg) {
+        arg.match(
+          [](boolean)    { black_unreachable(); }, // LCOV_EXCL_LINE
+          [](proposition) { 
+            // negated propositions are used as negative literals
+          },
+          [&](negation) { // LCOV_EXCL_LINE
+            // NOTE: this case should never be invoked because 
+            //       remove_booleans() removes double negations
+            black_unreachable(); // LCOV_EXCL_LINE
+          },
+          [&](conjunction c) { push_chain(c, flip(todo)); },
+          [&](disjunction d) { push_chain(d, flip(todo)); },
+          [&](implication, auto l, auto r) {
+            push(l, todo);
+            push(r, flip(todo));
+          },
+          [&](iff, auto l, auto r) {
+            push(l, both);
+            push(r, both);
+          }
+        );
+      }
+    );
+  }
 
+  //
+  // Emits the directions `todo` of the definition of `f`, given the 
+  // operands pushed by `expand()`. Each case below lists the clauses of the
+  // positive direction of the definition (f -> ...) and of the negative one
+  // (... -> f).
+  //
+  static void define(
+    formula f, polarity_t todo, std::span<formula const> ops, cnf &clauses
+  ) {
+    bool pos = todo & positive;
+    bool neg = todo & negative;
+    literal self = lit(f);
+    std::vector<literal> cl;
+
+    f.match(
+      [](boolean)     { }, // LCOV_EXCL_LINE
+      [](proposition) { },
+      [&](conjunction) 
+      {
         // clausal form for conjunctions:
-        //   f <-> (l ∧ r) == (!f ∨ l) ∧ (!f ∨ r) ∧ (!l ∨ !r ∨ f)
-        clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-          {{false, fresh(f)}, {true, fresh(l)}},
-          {{false, fresh(f)}, {true, fresh(r)}},
-          {{false, fresh(l)}, {false, fresh(r)}, {true, fresh(f)}}
-        });
+        //   f -> (l1 ∧ ... ∧ ln) == (!f ∨ l1) ∧ ... ∧ (!f ∨ ln)
+        //   (l1 ∧ ... ∧ ln) -> f == (!l1 ∨ ... ∨ !ln ∨ f)
+        if(pos)
+          for(formula op : ops)
+            clauses.add_clause({negated(self), lit(op)});
+        if(neg) {
+          for(formula op : ops)
+            cl.push_back(negated(lit(op)));
+          cl.push_back(self);
+          clauses.add_clause(cl);
+        }
       },
-      [&](disjunction, auto l, auto r) 
+      [&](disjunction) 
       {
-        tseitin(l, clauses, memo);
-        tseitin(r, clauses, memo);
-
         // clausal form for disjunctions:
-        //   f <-> (l ∨ r) == (f ∨ !l) ∧ (f ∨ !r) ∧ (l ∨ r ∨ !f)
-        clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-          {{true, fresh(f)}, {false, fresh(l)}},
-          {{true, fresh(f)}, {false, fresh(r)}},
-          {{true, fresh(l)}, {true, fresh(r)}, {false, fresh(f)}}
-        });
+        //   f -> (l1 ∨ ... ∨ ln) == (l1 ∨ ... ∨ ln ∨ !f)
+        //   (l1 ∨ ... ∨ ln) -> f == (f ∨ !l1) ∧ ... ∧ (f ∨ !ln)
+        if(pos) {
+          for(formula op : ops)
+            cl.push_back(lit(op));
+          cl.push_back(negated(self));
+          clauses.add_clause(cl);
+        }
+        if(neg)
+          for(formula op : ops)
+            clauses.add_clause({self, negated(lit(op))});
       },
-      [&](implication, auto l, auto r) 
+      [&](implication) 
       {
-        tseitin(l, clauses, memo);
-        tseitin(r, clauses, memo);
-
-        // clausal form for double implications:
-        //    f <-> (l -> r) == (!f ∨ !l ∨ r) ∧ (f ∨ l) ∧ (f ∨ !r)
-        clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-          {{false, fresh(f)}, {false, fresh(l)}, {true, fresh(r)}},
-          {{true,  fresh(f)}, {true,  fresh(l)}},
-          {{true,  fresh(f)}, {false, fresh(r)}}
-        });     
+        literal l = lit(ops[0]);
+        literal r = lit(ops[1]);
+
+        // clausal form for implications:
+        //    f -> (l -> r) == (!f ∨ !l ∨ r)
+        //    (l -> r) -> f == (f ∨ l) ∧ (f ∨ !r)
+        if(pos)
+          clauses.add_clause({negated(self), negated(l), r});
+        if(neg) {
+          clauses.add_clause({self, l});
+          clauses.add_clause({self, negated(r)});
+        }
       },
-      [&](iff, auto l, auto r) 
+      [&](iff) 
       {
-        tseitin(l, clauses, memo);
-        tseitin(r, clauses, memo);
+        literal l = lit(ops[0]);
+        literal r = lit(ops[1]);
 
         // clausal form for double implications:
-        //    f <-> (l <-> r) == (!f ∨ !l ∨  r) ∧ (!f ∨ l ∨ !r) ∧
-        //                       ( f ∨ !l ∨ !r) ∧ ( f ∨ l ∨  r)
-        clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-          {{false, fresh(f)}, {false, fresh(l)}, {true,  fresh(r)}},
-          {{false, fresh(f)}, {true,  fresh(l)}, {false, fresh(r)}},
-          {{true,  fresh(f)}, {false, fresh(l)}, {false, fresh(r)}},
-          {{true,  fresh(f)}, {true,  fresh(l)}, {true,  fresh(r)}}
-        });
+        //    f -> (l <-> r) == (!f ∨ !l ∨  r) ∧ (!f ∨ l ∨ !r)
+        //    (l <-> r) -> f == ( f ∨ !l ∨ !r) ∧ ( f ∨ l ∨  r)
+        if(pos) {
+          clauses.add_clause({negated(self), negated(l), r});
+          clauses.add_clause({negated(self), l, negated(r)});
+        }
+        if(neg) {
+          clauses.add_clause({self, negated(l), negated(r)});
+          clauses.add_clause({self, l, r});
+        }
       },
       [&](negation, auto arg) {
         return arg.match(  // LCOV_EXCL_LINE
           [](boolean)    { black_unreachable(); }, // LCOV_EXCL_LINE
-          [&](proposition a) {
-            // clausal form for negations:
-            // f <-> !p == (!f ∨ !p) ∧ (f ∨ p)
-            clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-              {{false, fresh(f)}, {false, fresh(a)}},
-              {{true,  fresh(f)}, {true,  fresh(a)}}
-            });
-          },
-          [&](negation) { // LCOV_EXCL_LINE
-            // NOTE: this case should never be invoked because 
-            //       remove_booleans() removes double negations
-            black_unreachable(); // LCOV_EXCL_LINE
-          },
-          [&](conjunction, auto l, auto r) {
-            tseitin(l, clauses, memo);
-            tseitin(r, clauses, memo);
-
-            // clausal form for negated conjunction:
-            //   f <-> !(l ∧ r) == (!f ∨ !l ∨ !r) ∧ (f ∨ l) ∧ (f ∨ r)
-            clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-              {{false, fresh(f)}, {false, fresh(l)}, {false, fresh(r)}},
-              {{true,  fresh(f)}, {true, fresh(l)}},
-              {{true,  fresh(f)}, {true, fresh(r)}},
-            });
+          [](proposition) { },
+          [&](negation) { black_unreachable(); }, // LCOV_EXCL_LINE
+          [&](conjunction) {
+            // clausal form for negated conjunctions:
+            //   f -> !(l1 ∧ ... ∧ ln) == (!f ∨ !l1 ∨ ... ∨ !ln)
+            //   !(l1 ∧ ... ∧ ln) -> f == (f ∨ l1) ∧ ... ∧ (f ∨ ln)
+            if(pos) {
+              cl.push_back(negated(self));
+              for(formula op : ops)
+                cl.push_back(negated(lit(op)));
+              clauses.add_clause(cl);
+            }
+            if(neg)
+              for(formula op : ops)
+                clauses.add_clause({self, lit(op)});
           },
-          [&](disjunction, auto l, auto r) {
-            tseitin(l, clauses, memo);
-            tseitin(r, clauses, memo);
-
-            // clausal form for negated disjunction:
-            //   f <-> !(l ∨ r) == (f ∨ l ∨ r) ∧ (!f ∨ !l) ∧ (!f ∨ !r)
-            clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-              {{true,  fresh(f)}, {true,  fresh(l)}, {true, fresh(r)}},
-              {{false, fresh(f)}, {false, fresh(l)}},
-              {{false, fresh(f)}, {false, fresh(r)}},
-            });
+          [&](disjunction) {
+            // clausal form for negated disjunctions:
+            //   f -> !(l1 ∨ ... ∨ ln) == (!f ∨ !l1) ∧ ... ∧ (!f ∨ !ln)
+            //   !(l1 ∨ ... ∨ ln) -> f == (f ∨ l1 ∨ ... ∨ ln)
+            if(pos)
+              for(formula op : ops)
+                clauses.add_clause({negated(self), negated(lit(op))});
+            if(neg) {
+              cl.push_back(self);
+              for(formula op : ops)
+                cl.push_back(lit(op));
+              clauses.add_clause(cl);
+            }
           },
-          [&](implication, auto l, auto r) 
+          [&](implication) 
           {
-            tseitin(l, clauses, memo);
-            tseitin(r, clauses, memo);
+            literal l = lit(ops[0]);
+            literal r = lit(ops[1]);
 
             // clausal form for negated implication:
-            //   f <-> (l ∧ r) == (!f ∨ l) ∧ (!f ∨ !r) ∧ (!l ∨ r ∨ f)
-            clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-              {{false, fresh(f)}, {true, fresh(l)}},
-              {{false, fresh(f)}, {false, fresh(r)}},
-              {{false, fresh(l)}, {true, fresh(r)}, {true, fresh(f)}}
-            });
+            //   f -> (l ∧ !r) == (!f ∨ l) ∧ (!f ∨ !r)
+            //   (l ∧ !r) -> f == (!l ∨ r ∨ f)
+            if(pos) {
+              clauses.add_clause({negated(self), l});
+              clauses.add_clause({negated(self), negated(r)});
+            }
+            if(neg)
+              clauses.add_clause({negated(l), r, self});
           },
-          [&](iff, auto l, auto r) {
-            tseitin(l, clauses, memo);
-            tseitin(r, clauses, memo);
+          [&](iff) {
+            literal l = lit(ops[0]);
+            literal r = lit(ops[1]);
 
             // clausal form for negated double implication (xor):
-            //    f <-> !(l <-> r) == (!f ∨ !l ∨ !r) ∧ (!f ∨  l ∨ r) ∧
-            //                        (f  ∨  l ∨ !r) ∧ (f  ∨ !l ∨ r)
-            clauses.insert(clauses.end(), { // LCOV_EXCL_LINE
-              {{false, fresh(f)}, {false, fresh(l)}, {false, fresh(r)}},
-              {{false, fresh(f)}, {true,  fresh(l)}, {true,  fresh(r)}},
-              {{true,  fresh(f)}, {true,  fresh(l)}, {false, fresh(r)}},
-              {{true,  fresh(f)}, {false, fresh(l)}, {true,  fresh(r)}}
-            });
+            //    f -> !(l <-> r) == (!f ∨ !l ∨ !r) ∧ (!f ∨  l ∨ r)
+            //    !(l <-> r) -> f == (f  ∨  l ∨ !r) ∧ (f  ∨ !l ∨ r)
+            if(pos) {
+              clauses.add_clause({negated(self), negated(l), negated(r)});
+              clauses.add_clause({negated(self), l, r});
+            }
+            if(neg) {
+              clauses.add_clause({self, l, negated(r)});
+              clauses.add_clause({self, negated(l), r});
+            }
           }
         );
       }
     );
   }
 
+  //
+  // Emits the definitions of `f` and of its subformulas, with the given
+  // polarity, in post-order. Formulas can be very deep, so the traversal 
+  // uses an explicit stack instead of recursion.
+  //
+  static void tseitin(
+    formula f, 
+    cnf &clauses, 
+    tseitin_memo &memo,
+    polarity_t polarity
+  ) {
+    std::vector<tseitin_frame_t> frames = {{f, polarity, {}}};
+    std::vector<formula> ops;
+
+    while(!frames.empty()) {
+      tseitin_frame_t &top = frames.back();
+
+      if(top.ops) {
+        size_t begin = *top.ops;
+        define(top.f, top.polarity, std::span{ops}.subspan(begin), clauses);
+        ops.erase(ops.begin() + ptrdiff_t(begin), ops.end());
+        frames.pop_back();
+        continue;
+      }
+
+      polarity_t todo = memo.insert(top.f, top.polarity);
+      if(!todo) {
+        frames.pop_back();
+        continue;
+      }
+
+      formula g = top.f;
+      top.polarity = todo;
+      top.ops = ops.size();
+
+      // reversed, so that the operands are converted from left to right
+      size_t first = frames.size();
+      expand(g, todo, memo, ops, frames);
+      std::reverse(frames.begin() + ptrdiff_t(first), frames.end());
+    }
+  }
+
   formula to_formula(literal lit) {
     return lit.sign ? formula{lit.prop} : formula{!lit.prop};
   }
 
-  formula to_formula(alphabet &sigma, clause c) {
-    return big_or(sigma, c.literals, [](literal lit){
+  formula to_formula(alphabet &sigma, std::span<literal const> c) {
+    return big_or(sigma, c, [](literal lit){
       return to_formula(lit);
     });
   }
 
-  formula to_formula(alphabet &sigma, cnf c) {
-    return big_and(sigma, c.clauses, [&](clause cl) {
+  formula to_formula(alphabet &sigma, clause const& c) {
+    return to_formula(sigma, std::span<literal const>{c.literals});
+  }
+
+  formula to_formula(alphabet &sigma, cnf const& c) {
+    return big_and(sigma, c, [&](std::span<literal const> cl) {
       return to_formula(sigma, cl);
     });
   }
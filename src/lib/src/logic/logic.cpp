@@ -27,6 +27,12 @@
 
 #include <variant>
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 
 //
 // This file contains the implementation of some components declared in
@@ -59,11 +65,10 @@ namespace black_internal::logic {
   // The `alphabet` class keeps an hash table from nodes to pointer to nodes.
   // When we insert a node, if it already exists, we get the existing copy of it
   // from the hash table. If it does not, we insert it in the hash table. This
-  // mechanism is implemented in the following class, which will be indirectly
-  // inherited by the pimpl class `alphabet_impl`.
+  // mechanism is implemented in the following class.
   //
   template<storage_type Storage>
-  struct storage_allocator {
+  struct storage_table {
     std::deque<storage_node<Storage>> _store;
     tsl::hopscotch_map<storage_node<Storage>, storage_node<Storage> *> _map;
    
@@ -79,6 +84,53 @@ namespace black_internal::logic {
     }
   };
 
+  //
+  // Concurrent alphabets split the nodes of each storage kind among a number
+  // of shards, each one with its own table and its own lock. Since nodes are
+  // stored in `std::deque`s, their addresses are stable and can be handed out
+  // without holding the lock. The shard of a node is selected by the high bits
+  // of its (mixed) hash value, so to be independent from the low bits used
+  // by the shard's hash table.
+  //
+  template<storage_type Storage>
+  struct storage_shard : storage_table<Storage> {
+    std::mutex _mutex;
+  };
+
+  inline size_t shard_index(size_t hash, size_t bits) {
+    uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(mixed >> (64 - bits));
+  }
+
+  //
+  // The following class will be indirectly inherited by the pimpl class
+  // `alphabet_impl`. It uses a single unsynchronized table unless
+  // `make_concurrent()` is called, before any node is allocated.
+  //
+  template<storage_type Storage>
+  struct storage_allocator {
+    storage_table<Storage> _table;
+    std::unique_ptr<storage_shard<Storage>[]> _shards;
+    size_t _shard_bits = 0;
+
+    void make_concurrent(size_t bits) {
+      black_assert(_table._store.empty());
+      _shards = std::make_unique<storage_shard<Storage>[]>(size_t{1} << bits);
+      _shard_bits = bits;
+    }
+   
+    storage_node<Storage> *allocate(storage_node<Storage> const& node) {
+      if(!_shards)
+        return _table.allocate(node);
+
+      size_t hash = std::hash<storage_node<Storage>>{}(node);
+      storage_shard<Storage> &shard = _shards[shard_index(hash, _shard_bits)];
+
+      std::lock_guard lock{shard._mutex};
+      return shard.allocate(node);
+    }
+  };
+
   //
   // We specialize the case of a single boolean field (i.e. the `boolean`
   // storage kind). Other optimized specializations could be possible in the
@@ -93,6 +145,9 @@ namespace black_internal::logic {
     storage_node<Storage> _true{element_of_storage_v<Storage>, true};
     storage_node<Storage> _false{element_of_storage_v<Storage>, false};
     
+    // the two nodes are immutable, so there is nothing to synchronize
+    void make_concurrent(size_t) { }
+    
     storage_node<Storage> *allocate(storage_node<Storage> node) {
       if(std::get<0>(node.data.values))
         return &_true;
@@ -105,6 +160,20 @@ namespace black_internal::logic {
     , storage_allocator<storage_type::Storage>
   #include <black/internal/logic/hierarchy.hpp>
   { 
+    explicit alphabet_impl(bool concurrent) {
+      if(!concurrent)
+        return;
+
+      // enough shards to make contention unlikely with all the hardware
+      // threads working together, but not so many to waste memory
+      size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+      size_t bits = std::min<size_t>(std::bit_width(2 * threads - 1), 6);
+
+      #define declare_storage_kind(Base, Storage) \
+        storage_allocator<storage_type::Storage>::make_concurrent(bits);
+      #include <black/internal/logic/hierarchy.hpp>
+    }
+
     #define declare_storage_kind(Base, Storage) \
       using storage_allocator<storage_type::Storage>::allocate;
     #include <black/internal/logic/hierarchy.hpp>
@@ -115,13 +184,23 @@ namespace black_internal::logic {
   // declared in `generation.hpp`
   //
   alphabet_base::alphabet_base() : _impl{nullptr} { }
+  
+  // the impl is created eagerly, because the lazy creation in `impl()` is not
+  // thread-safe
+  alphabet_base::alphabet_base(concurrent_t) 
+    : _impl{std::make_unique<alphabet_impl>(true)}, _concurrent{true} { }
+
   alphabet_base::alphabet_base(alphabet_base &&) = default;
   alphabet_base &alphabet_base::operator=(alphabet_base &&) = default;
   alphabet_base::~alphabet_base() = default;
 
+  bool alphabet_base::is_concurrent() const {
+    return _concurrent;
+  }
+
   alphabet_base::alphabet_impl *alphabet_base::impl() {
     if(!_impl)
-      _impl = std::make_unique<alphabet_impl>();
+      _impl = std::make_unique<alphabet_impl>(_concurrent);
       
     return _impl.get();
   }
@@ -28,6 +28,11 @@
 
 #include <tsl/hopscotch_map.h>
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+
 BLACK_REGISTER_SAT_BACKEND(cmsat, {})
 
 namespace black_internal::cmsat
@@ -36,9 +41,100 @@ namespace black_internal::cmsat
     std::unique_ptr<CMSat::SATSolver> solver;
     bool model_available = false;
 
-    _cmsat_t() {
+    // reused by `assert_clause()` to avoid an allocation for each clause
+    std::vector<CMSat::Lit> buffer;
+
+    // set by `interrupt()` until the end of the current call to the solver.
+    // CryptoMiniSat forgets the interrupts coming before the search starts,
+    // so those are caught by this flag
+    std::atomic<bool> interrupted = false;
+
+    // guards `solver` against concurrent calls to `interrupt()`
+    std::mutex mutex;
+
+    // the options given with set_option(), applied by `reset()` before any
+    // variable is created, as CryptoMiniSat requires for some of them
+    std::vector<std::pair<std::string, black::sat::option_value>> options;
+
+    _cmsat_t() { reset(); }
+
+    void reset() {
+      std::lock_guard lock{mutex};
       solver = std::make_unique<CMSat::SATSolver>();
+      for(auto const& [key, value] : options)
+        apply(*solver, key, value);
       solver->new_var();
+      model_available = false;
+      interrupted = false;
+    }
+
+    //
+    // Applies an option, returning false if it is unknown or if the value is
+    // not valid. Options to turn off some simplification take `false` only.
+    //
+    static bool apply(
+      CMSat::SATSolver &s, std::string_view key, 
+      black::sat::option_value const& value
+    ) {
+      using black::sat::option_as;
+
+      if(key == "threads") {
+        auto n = option_as<int64_t>(value);
+        if(!n || *n < 1 || *n > std::numeric_limits<int>::max())
+          return false;
+        s.set_num_threads(unsigned(*n));
+        return true;
+      }
+      if(key == "polarity") {
+        if(auto pol = option_as<bool>(value); pol) {
+          s.set_default_polarity(*pol);
+          return true;
+        }
+        if(option_as<std::string>(value) == "auto") {
+          s.set_polarity_auto();
+          return true;
+        }
+        return false;
+      }
+      if(key == "max_time") {
+        auto t = option_as<double>(value);
+        if(!t || *t <= 0)
+          return false;
+        s.set_max_time(*t);
+        return true;
+      }
+      if(key == "simplify" || key == "bve" || key == "bva") {
+        auto on = option_as<bool>(value);
+        if(!on)
+          return false;
+        if(*on) // the default
+          return true;
+        
+        if(key == "simplify")
+          s.set_no_simplify();
+        else if(key == "bve")
+          s.set_no_bve();
+        else
+          s.set_no_bva();
+        return true;
+      }
+
+      return false;
+    }
+
+    //
+    // An interrupt coming in the short window between the check of the 
+    // flag and the start of the search is still forgotten by CryptoMiniSat,
+    // and the call runs to its end. Its answer is correct anyway, and the
+    // callers check their own interrupt flags after each call.
+    //
+    CMSat::lbool solve(std::vector<CMSat::Lit> const* assumptions) {
+      CMSat::lbool ret = CMSat::l_Undef;
+      if(!interrupted)
+        ret = solver->solve(assumptions);
+      interrupted = false;
+
+      return ret;
     }
   };
 
@@ -52,8 +148,9 @@ namespace black_internal::cmsat
   }
   
   void cmsat::assert_clause(dimacs::clause cl) {
-    std::vector<CMSat::Lit> lits;
-    for(dimacs::literal lit : cl.literals) {
+    std::vector<CMSat::Lit> &lits = _data->buffer;
+    lits.clear();
+    for(dimacs::literal lit : cl) {
       lits.push_back(CMSat::Lit{lit.var, !lit.sign});
     }
 
@@ -61,13 +158,13 @@ namespace black_internal::cmsat
   }
 
   tribool cmsat::is_sat() {
-    CMSat::lbool ret = _data->solver->solve();
+    CMSat::lbool ret = _data->solve(nullptr);
     if(ret == CMSat::l_True)
       _data->model_available = true;
 
     return ret == CMSat::l_True ? tribool{true} :
            ret == CMSat::l_False ? tribool{false} :
-           tribool::undef; // LCOV_EXCL_LINE
+           tribool::undef;
   }
 
   tribool cmsat::is_sat_with(std::vector<dimacs::literal> const& assumptions) {
@@ -76,13 +173,22 @@ namespace black_internal::cmsat
       lits.push_back(CMSat::Lit{lit.var, !lit.sign});
     }
 
-    CMSat::lbool ret = _data->solver->solve(&lits);
+    CMSat::lbool ret = _data->solve(&lits);
     if(ret == CMSat::l_True)
       _data->model_available = true;
 
     return ret == CMSat::l_True ? tribool{true} :
            ret == CMSat::l_False ? tribool{false} :
-           tribool::undef;  // LCOV_EXCL_LINE
+           tribool::undef;
+  }
+
+  bool cmsat::failed(dimacs::literal lit) const {
+    // the conflict contains the negation of the failed assumptions
+    std::vector<CMSat::Lit> const& conflict = _data->solver->get_conflict();
+    CMSat::Lit negated = ~CMSat::Lit{lit.var, !lit.sign};
+
+    return std::find(conflict.begin(), conflict.end(), negated) != 
+           conflict.end();
   }
 
   tribool cmsat::value(uint32_t v) const {
@@ -101,10 +207,29 @@ namespace black_internal::cmsat
 
   void cmsat::clear() {
     this->clear_vars();
-    _data = std::make_unique<_cmsat_t>();
+    _data->reset();
+  }
+
+  void cmsat::interrupt() {
+    std::lock_guard lock{_data->mutex};
+    _data->interrupted = true;
+    _data->solver->interrupt_asap();
   }
 
-  void cmsat::interrupt() { }
+  bool cmsat::set_option(
+    std::string_view key, black::sat::option_value const& value
+  ) {
+    // the options are validated on a scratch solver, because some of them 
+    // cannot be applied after the creation of variables
+    CMSat::SATSolver scratch;
+    if(!_data->apply(scratch, key, value))
+      return false;
+
+    _data->options.push_back({std::string{key}, value});
+    clear();
+    
+    return true;
+  }
 
   std::optional<std::string> cmsat::license() const
   {
@@ -30,6 +30,8 @@
 #include <cvc5/cvc5.h>
 #include <tsl/hopscotch_map.h>
 
+#include <algorithm>
+
 BLACK_REGISTER_SAT_BACKEND(cvc5, {
   black::sat::feature::smt, black::sat::feature::quantifiers
 })
@@ -46,15 +48,51 @@ namespace black_internal::cvc5
     class scope xi;
 
     _cvc5_t(logic::scope const& _xi) 
-      : global_xi{chain(_xi)}, xi{chain(global_xi)} { }
+      : global_xi{chain(_xi)}, xi{chain(global_xi)}, caches(1) { }
 
     cvc::Solver solver;
     bool sat_response = false;
+    std::vector<formula> failed;
+
+    // cvc5 only accepts the logic and most options before it is fully 
+    // initialized, which happens with the first assertion or check, so 
+    // the logic is set right before that
+    std::string smt_logic = "ALL";
+    bool initialized = false;
+
+    void init() {
+      if(!initialized)
+        solver.setLogic(smt_logic);
+      initialized = true;
+    }
 
     tsl::hopscotch_map<proposition, cvc::Term> props;
 
+    // Translations of the formulas and terms already seen, shared by the
+    // assertions, the assumptions and the model queries. The variables bound
+    // by a quantifier may change the translation of its subformulas, so a 
+    // new cache is pushed for each quantifier, and dropped at its end.
+    struct cache_t {
+      tsl::hopscotch_map<formula, cvc::Term> formulas;
+      tsl::hopscotch_map<term, cvc::Term> terms;
+    };
+    std::vector<cache_t> caches;
+
+    // pushes the cache of a quantifier, and drops it at the end of the 
+    // scope, also if cvc5 throws in the middle of the translation
+    struct nest_cache_t {
+      std::vector<cache_t> &caches;
+
+      nest_cache_t(std::vector<cache_t> &c) : caches{c} { 
+        caches.emplace_back(); 
+      }
+      ~nest_cache_t() { caches.pop_back(); }
+    };
+
     cvc::Term to_cvc5(formula);
     cvc::Term to_cvc5(term);
+    cvc::Term to_cvc5_inner(formula);
+    cvc::Term to_cvc5_inner(term);
     cvc::Term to_cvc5(function);
     cvc::Term to_cvc5(relation);
     cvc::Sort to_cvc5(std::optional<sort>);
@@ -63,8 +101,8 @@ namespace black_internal::cvc5
 
   cvc5::cvc5(class scope const&xi) : _data{std::make_unique<_cvc5_t>(xi)}
   {
-    _data->solver.setLogic("ALL");
     _data->solver.setOption("produce-models", "true");
+    _data->solver.setOption("produce-unsat-assumptions", "true");
     _data->solver.setOption("finite-model-find", "true");
   }
 
@@ -72,23 +110,40 @@ namespace black_internal::cvc5
 
   void cvc5::assert_formula(formula f) {
     cvc::Term term = _data->to_cvc5(f);
+    _data->init();
     _data->solver.assertFormula(term);
   }
 
-  tribool cvc5::is_sat_with(formula f) 
+  tribool cvc5::is_sat_with(std::vector<formula> const& assumptions) 
   {
-    cvc::Term term = _data->to_cvc5(f);
+    std::vector<cvc::Term> terms;
+    for(formula f : assumptions)
+      terms.push_back(_data->to_cvc5(f));
 
-    cvc::Result res = _data->solver.checkSatAssuming(term);
+    _data->init();
+    cvc::Result res = _data->solver.checkSatAssuming(terms);
     _data->sat_response = res.isSat();
 
+    _data->failed.clear();
+    if(res.isUnsat()) {
+      std::vector<cvc::Term> core = _data->solver.getUnsatAssumptions();
+      for(size_t i = 0; i < terms.size(); ++i)
+        if(std::find(core.begin(), core.end(), terms[i]) != core.end())
+          _data->failed.push_back(assumptions[i]);
+    }
+
     return res.isSat() ? tribool{true} :
            res.isUnsat() ? tribool{false} :
            tribool::undef; // LCOV_EXCL_LINE
   }
 
+  std::vector<formula> cvc5::failed_assumptions() const {
+    return _data->failed;
+  }
+
   tribool cvc5::is_sat() 
   {
+    _data->init();
     cvc::Result res = _data->solver.checkSat();
     _data->sat_response = res.isSat();
 
@@ -158,11 +213,43 @@ namespace black_internal::cvc5
   }
 
   void cvc5::clear() {
+    _data->init();
     _data->solver.resetAssertions();
   }
 
   void cvc5::interrupt() { }
 
+  //
+  // The `logic` option replaces the default `ALL` logic, and any other option
+  // is passed to cvc5 as is. Options are only accepted before the first 
+  // assertion or check.
+  //
+  bool cvc5::set_option(
+    std::string_view key, black::sat::option_value const& value
+  ) {
+    if(_data->initialized)
+      return false;
+
+    try {
+      if(key == "logic") {
+        auto name = black::sat::option_as<std::string>(value);
+        if(!name)
+          return false;
+        
+        // cvc5 checks the logic only when setting it, which can be done 
+        // only once in recent versions, so we check it on a scratch solver
+        cvc::Solver scratch;
+        scratch.setLogic(*name);
+        _data->smt_logic = *name;
+      } else
+        _data->solver.setOption(std::string{key}, black::sat::to_string(value));
+    } catch(cvc::CVC5ApiException const&) {
+      return false;
+    }
+
+    return true;
+  }
+
   cvc::Sort cvc5::_cvc5_t::to_cvc5(std::optional<sort> s) {
     black_assert(s.has_value());
     
@@ -198,6 +285,17 @@ namespace black_internal::cvc5
   }
 
   cvc::Term cvc5::_cvc5_t::to_cvc5(formula f) {
+    if(auto it = caches.back().formulas.find(f); 
+       it != caches.back().formulas.end())
+      return it->second;
+
+    cvc::Term result = to_cvc5_inner(f);
+    caches.back().formulas.insert({f, result});
+
+    return result;
+  }
+
+  cvc::Term cvc5::_cvc5_t::to_cvc5_inner(formula f) {
     return f.match(
       [&](boolean b) { // LCOV_EXCL_LINE
         return b.value() ? solver.mkTrue() : solver.mkFalse();
@@ -245,6 +343,7 @@ namespace black_internal::cvc5
       },
       [&](quantifier q) { // LCOV_EXCL_LINE
         logic::nest_scope_t nest{xi};
+        nest_cache_t nest_cache{caches};
         
         std::vector<cvc::Term> vars;
         for(auto decl : q.variables()) {
@@ -342,6 +441,16 @@ namespace black_internal::cvc5
   }
 
   cvc::Term cvc5::_cvc5_t::to_cvc5(term t) {
+    if(auto it = caches.back().terms.find(t); it != caches.back().terms.end())
+      return it->second;
+
+    cvc::Term result = to_cvc5_inner(t);
+    caches.back().terms.insert({t, result});
+
+    return result;
+  }
+
+  cvc::Term cvc5::_cvc5_t::to_cvc5_inner(term t) {
     return t.match(
       [&](constant, auto n) { // LCOV_EXCL_LINE
         return n.match(
@@ -380,9 +489,12 @@ namespace black_internal::cvc5
           }
         }
 
-        // if not, this is a normal variable
+        // if not, this is a free variable. It is recorded in the global 
+        // scope, because cvc5 would make a distinct constant at each call of
+        // `mkConst()`, e.g. if the variable is met again outside of the 
+        // quantifier where it was first met
         cvc::Term term = solver.mkConst(cvcSort, to_string(v.unique_id()));
-        xi.set_data(v, term);
+        global_xi.set_data(v, term);
         return term;
       },
       [&](application a) { // LCOV_EXCL_LINE
@@ -0,0 +1,232 @@
+//
+// BLACK - Bounded Ltl sAtisfiability ChecKer
+//
+// (C) 2020 Nicola Gigante
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <black/sat/backends/ipasir.hpp>
+
+#include <dlfcn.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+namespace black_internal::ipasir
+{
+  namespace {
+
+    //
+    // An IPASIR library opened with dlopen(), with the entry points we use
+    //
+    struct library_t {
+      void *handle = nullptr;
+      std::string path;
+
+      const char *(*signature)() = nullptr;
+      void *(*init)() = nullptr;
+      void (*release)(void *) = nullptr;
+      void (*add)(void *, int32_t) = nullptr;
+      void (*assume)(void *, int32_t) = nullptr;
+      int (*solve)(void *) = nullptr;
+      int32_t (*val)(void *, int32_t) = nullptr;
+      int (*failed)(void *, int32_t) = nullptr;
+      void (*set_terminate)(void *, void *, int (*)(void *)) = nullptr;
+
+      library_t() = default;
+      library_t(library_t const&) = delete;
+      library_t &operator=(library_t const&) = delete;
+
+      ~library_t() {
+        if(handle)
+          dlclose(handle);
+      }
+    };
+
+    // the library used by newly created backends. Backends keep their own
+    // reference, so loading another library does not affect existing ones
+    std::mutex library_mutex;
+    std::shared_ptr<library_t const> current_library;
+
+    template<typename F>
+    bool resolve(library_t &lib, F &f, const char *name) {
+      f = reinterpret_cast<F>(dlsym(lib.handle, name));
+      return f != nullptr;
+    }
+
+    void register_backend() {
+      static const black::sat::internal::backend_init_hook hook{
+        "ipasir",
+        [](black::logic::scope const& xi) 
+          -> std::unique_ptr<black::sat::solver> 
+        {
+          return std::make_unique<ipasir>(xi);
+        },
+        {}
+      };
+    }
+  }
+
+  std::optional<std::string> ipasir::load(std::string const& path) {
+    auto lib = std::make_shared<library_t>();
+    lib->path = path;
+    lib->handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(!lib->handle) {
+      const char *error = dlerror();
+      return error ? error : "unable to load '" + path + "'";
+    }
+
+    bool ok = 
+      resolve(*lib, lib->signature, "ipasir_signature") &&
+      resolve(*lib, lib->init, "ipasir_init") &&
+      resolve(*lib, lib->release, "ipasir_release") &&
+      resolve(*lib, lib->add, "ipasir_add") &&
+      resolve(*lib, lib->assume, "ipasir_assume") &&
+      resolve(*lib, lib->solve, "ipasir_solve") &&
+      resolve(*lib, lib->val, "ipasir_val") &&
+      resolve(*lib, lib->failed, "ipasir_failed") &&
+      resolve(*lib, lib->set_terminate, "ipasir_set_terminate");
+    
+    if(!ok)
+      return "'" + path + "' does not implement the IPASIR interface";
+
+    {
+      std::lock_guard lock{library_mutex};
+      current_library = std::move(lib);
+    }
+    register_backend();
+
+    return {};
+  }
+
+  namespace {
+    [[maybe_unused]]
+    const bool library_from_env = [] {
+      const char *path = std::getenv("BLACK_IPASIR_LIBRARY");
+      return path && !ipasir::load(path).has_value();
+    }();
+  }
+
+  struct ipasir::_ipasir_t {
+    std::shared_ptr<library_t const> lib;
+    void *solver = nullptr;
+    int state = 0; // result of the last ipasir_solve() call
+    std::atomic<bool> interrupted = false;
+
+    _ipasir_t() {
+      std::lock_guard lock{library_mutex};
+      lib = current_library;
+      black_assert(lib);
+      init();
+    }
+
+    ~_ipasir_t() {
+      lib->release(solver);
+    }
+
+    static int terminate(void *data) {
+      return static_cast<_ipasir_t *>(data)->interrupted;
+    }
+
+    void init() {
+      solver = lib->init();
+      lib->set_terminate(solver, this, &terminate);
+      state = 0;
+      interrupted = false;
+    }
+
+    static int32_t to_ipasir(dimacs::literal l) {
+      return l.sign ? int32_t(l.var) : -int32_t(l.var);
+    }
+
+    tribool solve() {
+      int result = lib->solve(solver);
+      
+      // the flag is only reset here, so interrupts coming before the search
+      // starts are seen by the first call to the callback
+      interrupted = false;
+      state = result;
+
+      return result == 10 ? tribool{true} :
+             result == 20 ? tribool{false} :
+             tribool::undef;
+    }
+  };
+
+  ipasir::ipasir(black::logic::scope const&) 
+    : _data{std::make_unique<_ipasir_t>()} { }
+
+  ipasir::~ipasir() { }
+
+  // IPASIR solvers allocate variables on first use
+  void ipasir::new_vars(size_t) { }
+
+  void ipasir::assert_clause(dimacs::clause cl) {
+    for(dimacs::literal l : cl)
+      _data->lib->add(_data->solver, _ipasir_t::to_ipasir(l));
+    _data->lib->add(_data->solver, 0);
+  }
+
+  tribool ipasir::is_sat() {
+    return _data->solve();
+  }
+
+  tribool 
+  ipasir::is_sat_with(std::vector<dimacs::literal> const& assumptions) {
+    for(dimacs::literal l : assumptions)
+      _data->lib->assume(_data->solver, _ipasir_t::to_ipasir(l));
+
+    return _data->solve();
+  }
+
+  bool ipasir::failed(dimacs::literal l) const {
+    if(_data->state != 20)
+      return true;
+    
+    return _data->lib->failed(_data->solver, _ipasir_t::to_ipasir(l)) != 0;
+  }
+
+  tribool ipasir::value(uint32_t v) const {
+    if(_data->state != 10 || v == 0)
+      return tribool::undef;
+
+    int32_t val = _data->lib->val(_data->solver, int32_t(v));
+    return val > 0 ? tribool{true} :
+           val < 0 ? tribool{false} :
+           tribool::undef;
+  }
+
+  void ipasir::clear() {
+    this->clear_vars();
+    _data->lib->release(_data->solver);
+    _data->init();
+  }
+
+  void ipasir::interrupt() {
+    _data->interrupted = true;
+  }
+
+  std::optional<std::string> ipasir::license() const {
+    return 
+      "IPASIR backend using '" + std::string{_data->lib->signature()} + 
+      "', loaded from '" + _data->lib->path + "'.\n" +
+      "Refer to the library for its own license terms.";
+  }
+}
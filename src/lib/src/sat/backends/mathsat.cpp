@@ -32,6 +32,7 @@
 #include <fmt/format.h>
 #include <tsl/hopscotch_map.h>
 
+#include <atomic>
 #include <string>
 
 BLACK_REGISTER_SAT_BACKEND(mathsat, {black::sat::feature::smt})
@@ -50,6 +51,20 @@ namespace black_internal::mathsat
     tsl::hopscotch_map<relation, msat_decl> relations;
     tsl::hopscotch_map<term, msat_decl> variables;
     std::optional<msat_model> model;
+    std::vector<formula> failed;
+
+    // set by `interrupt()` until the end of the current call to the solver,
+    // and polled by MathSAT through `terminate()`
+    std::atomic<bool> interrupted = false;
+
+    static int terminate(void *data) {
+      return static_cast<_mathsat_t *>(data)->interrupted ? 1 : 0;
+    }
+
+    // the options given with set_option(), in textual form
+    std::vector<std::pair<std::string, std::string>> options;
+
+    std::optional<msat_env> make_env();
 
     msat_term to_mathsat(formula);
     msat_term to_mathsat_inner(formula);
@@ -66,13 +81,35 @@ namespace black_internal::mathsat
     }
   };
 
-  mathsat::mathsat(scope const&xi) : _data{std::make_unique<_mathsat_t>(xi)}
-  {  
+  // creates an environment with our configuration and the options given 
+  // with set_option(), unless MathSAT rejects them
+  std::optional<msat_env> mathsat::_mathsat_t::make_env() {
     msat_config cfg = msat_create_config();
     msat_set_option(cfg, "model_generation", "true");
     msat_set_option(cfg, "unsat_core_generation","3");
+
+    for(auto const& [key, value] : options) {
+      if(msat_set_option(cfg, key.c_str(), value.c_str()) != 0) {
+        msat_destroy_config(cfg);
+        return {};
+      }
+    }
     
-    _data->env = msat_create_env(cfg);
+    msat_env e = msat_create_env(cfg);
+    if(MSAT_ERROR_ENV(e)) {
+      msat_destroy_config(cfg);
+      return {};
+    }
+    msat_set_termination_test(e, &_mathsat_t::terminate, this);
+
+    return e;
+  }
+
+  mathsat::mathsat(scope const&xi) : _data{std::make_unique<_mathsat_t>(xi)}
+  {  
+    std::optional<msat_env> env = _data->make_env();
+    black_assert(env.has_value());
+    _data->env = *env;
   }
 
   mathsat::~mathsat() { }
@@ -83,6 +120,7 @@ namespace black_internal::mathsat
 
   tribool mathsat::is_sat() { 
     msat_result res = msat_solve(_data->env);
+    _data->interrupted = false;
 
     if(res == MSAT_SAT) {
       if(_data->model)
@@ -94,15 +132,40 @@ namespace black_internal::mathsat
 
     return res == MSAT_SAT ? tribool{true} :
            res == MSAT_UNSAT ? tribool{false} :
-           tribool::undef; // LCOV_EXCL_LINE
+           tribool::undef;
   }
 
-  tribool mathsat::is_sat_with(formula f) 
+  tribool mathsat::is_sat_with(std::vector<formula> const& assumptions) 
   {
-    msat_push_backtrack_point(_data->env);
-  
-    assert_formula(f);
-    msat_result res = msat_solve(_data->env);
+    // MathSAT only accepts literals as assumptions, so the other formulas 
+    // are asserted inside a backtrack point popped after the call
+    std::vector<msat_term> literals;
+    std::vector<formula> given;
+    std::vector<formula> complex;
+    for(formula f : assumptions) {
+      bool literal = f.match(
+        [](proposition) { return true; },
+        [](negation, auto arg) { return arg.template is<proposition>(); },
+        [](otherwise) { return false; }
+      );
+
+      if(literal) {
+        literals.push_back(_data->to_mathsat(f));
+        given.push_back(f);
+      } else
+        complex.push_back(f);
+    }
+
+    if(!complex.empty()) {
+      msat_push_backtrack_point(_data->env);
+      for(formula f : complex)
+        assert_formula(f);
+    }
+
+    msat_result res = msat_solve_with_assumptions(
+      _data->env, literals.data(), literals.size()
+    );
+    _data->interrupted = false;
 
     if(res == MSAT_SAT) {
       if(_data->model)
@@ -111,11 +174,37 @@ namespace black_internal::mathsat
       _data->model = msat_get_model(_data->env);
       black_assert(!MSAT_ERROR_MODEL(*_data->model));
     }
+
+    // the formulas asserted in the backtrack point are conservatively 
+    // considered all failed
+    _data->failed.clear();
+    if(res == MSAT_UNSAT) {
+      size_t size = 0;
+      msat_term *core = msat_get_unsat_assumptions(_data->env, &size);
+      for(size_t i = 0; i < literals.size(); ++i) {
+        for(size_t j = 0; core && j < size; ++j) {
+          if(msat_term_id(core[j]) == msat_term_id(literals[i])) {
+            _data->failed.push_back(given[i]);
+            break;
+          }
+        }
+      }
+      if(core)
+        msat_free(core);
+      
+      _data->failed.insert(_data->failed.end(), complex.begin(), complex.end());
+    }
   
-    msat_pop_backtrack_point(_data->env);
+    if(!complex.empty())
+      msat_pop_backtrack_point(_data->env);
+
     return res == MSAT_SAT ? tribool{true} :
            res == MSAT_UNSAT ? tribool{false} :
-           tribool::undef; // LCOV_EXCL_LINE
+           tribool::undef;
+  }
+
+  std::vector<formula> mathsat::failed_assumptions() const {
+    return _data->failed;
   }
 
   tribool mathsat::value(proposition a) const {
@@ -183,9 +272,46 @@ namespace black_internal::mathsat
 
   void mathsat::clear() {
     msat_reset_env(_data->env);
+    _data->interrupted = false;
+    msat_set_termination_test(_data->env, &_mathsat_t::terminate, _data.get());
   }
   
-  void mathsat::interrupt() { }
+  void mathsat::interrupt() { 
+    _data->interrupted = true;
+  }
+
+  //
+  // The options are those of MathSAT's configuration, which is only read
+  // when creating the environment. Hence the environment is created again,
+  // and the translations made so far, which belong to the old one, are 
+  // dropped.
+  //
+  bool mathsat::set_option(
+    std::string_view key, black::sat::option_value const& value
+  ) {
+    _data->options.push_back({std::string{key}, black::sat::to_string(value)});
+    
+    std::optional<msat_env> env = _data->make_env();
+    if(!env) {
+      _data->options.pop_back();
+      return false;
+    }
+
+    if(_data->model)
+      msat_destroy_model(*_data->model);
+    _data->model.reset();
+    _data->formulas.clear();
+    _data->terms.clear();
+    _data->functions.clear();
+    _data->relations.clear();
+    _data->variables.clear();
+    _data->failed.clear();
+    
+    msat_destroy_env(_data->env);
+    _data->env = *env;
+
+    return true;
+  }
 
   msat_term mathsat::_mathsat_t::to_mathsat(formula f) 
   {
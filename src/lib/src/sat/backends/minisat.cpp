@@ -27,6 +27,9 @@
 #include <minisat/simp/SimpSolver.h>
 #include <tsl/hopscotch_map.h>
 
+#include <limits>
+#include <mutex>
+
 BLACK_REGISTER_SAT_BACKEND(minisat, {})
 
 namespace black_internal::minisat
@@ -34,31 +37,126 @@ namespace black_internal::minisat
 
   struct minisat::_minisat_t {
     std::unique_ptr<Minisat::SimpSolver> solver;
-    size_t nvars;
+    size_t nvars = 0;
     bool model_available = false;
 
-    _minisat_t() {
+    // reused by `assert_clause()` to avoid an allocation for each clause
+    Minisat::vec<Minisat::Lit> buffer;
+
+    // guards `solver` against concurrent calls to `interrupt()`
+    std::mutex mutex;
+
+    // the options given with set_option(), applied again by `reset()`
+    std::vector<std::pair<std::string, black::sat::option_value>> options;
+
+    _minisat_t() { reset(); }
+
+    void reset() {
+      std::lock_guard lock{mutex};
       solver = std::make_unique<Minisat::SimpSolver>();
       solver->verbosity = -1;
       solver->use_elim = false;
+      for(auto const& [key, value] : options)
+        apply(*solver, key, value);
       solver->newVar();
+      nvars = 0;
+      model_available = false;
+    }
+
+    // sets `field` to `value`, if it has the right type and it is within 
+    // the given bounds
+    template<typename T, typename U>
+    static bool set(
+      U &field, black::sat::option_value const& value, 
+      T min = std::numeric_limits<T>::lowest(), 
+      T max = std::numeric_limits<T>::max()
+    ) {
+      std::optional<T> v = black::sat::option_as<T>(value);
+      if(!v || *v < min || *v > max)
+        return false;
+      field = U(*v);
+      return true;
+    }
+
+    // the options are the fields of MiniSat's solver of the same name, 
+    // with about the same bounds as MiniSat's command-line options
+    static bool apply(
+      Minisat::SimpSolver &s, std::string_view key, 
+      black::sat::option_value const& value
+    ) {
+      if(key == "use_elim")
+        return set<bool>(s.use_elim, value);
+      if(key == "use_asymm")
+        return set<bool>(s.use_asymm, value);
+      if(key == "use_rcheck")
+        return set<bool>(s.use_rcheck, value);
+      if(key == "luby_restart")
+        return set<bool>(s.luby_restart, value);
+      if(key == "rnd_init_act")
+        return set<bool>(s.rnd_init_act, value);
+      if(key == "var_decay")
+        return set<double>(s.var_decay, value, 0, 1);
+      if(key == "clause_decay")
+        return set<double>(s.clause_decay, value, 0, 1);
+      if(key == "random_var_freq")
+        return set<double>(s.random_var_freq, value, 0, 1);
+      if(key == "random_seed")
+        return set<double>(
+          s.random_seed, value, std::numeric_limits<double>::min()
+        );
+      if(key == "restart_inc")
+        return set<double>(s.restart_inc, value, 1);
+      if(key == "garbage_frac")
+        return set<double>(s.garbage_frac, value, 0);
+      if(key == "restart_first")
+        return set<int64_t>(
+          s.restart_first, value, 1, std::numeric_limits<int>::max()
+        );
+      if(key == "phase_saving")
+        return set<int64_t>(s.phase_saving, value, 0, 2);
+      if(key == "ccmin_mode")
+        return set<int64_t>(s.ccmin_mode, value, 0, 2);
+      
+      return false;
+    }
+
+    // MiniSat keeps the interrupt flag set until it is cleared, so 
+    // interrupts coming before the search starts are not lost
+    tribool solve(Minisat::vec<Minisat::Lit> const& assumptions) {
+      Minisat::lbool ret = solver->solveLimited(assumptions);
+      
+      std::lock_guard lock{mutex};
+      solver->clearInterrupt();
+      model_available = ret == Minisat::l_True;
+
+      return ret == Minisat::l_True ? tribool{true} :
+             ret == Minisat::l_False ? tribool{false} :
+             tribool::undef;
     }
   };
 
-  minisat::minisat() : _data{std::make_unique<_minisat_t>()} { }
+  minisat::minisat(black::logic::scope const&) 
+    : _data{std::make_unique<_minisat_t>()} { }
 
   minisat::~minisat() { }
 
   void minisat::new_vars(size_t n) {
     for(size_t i = 0; i < n; ++i) {
-      _data->solver->newVar();
+      Minisat::Var v = _data->solver->newVar();
       _data->nvars++;
+
+      // any variable can appear in later clauses or assumptions, so it must
+      // not be eliminated. Simplification is then limited to subsumption and
+      // self-subsuming resolution.
+      if(_data->solver->use_elim)
+        _data->solver->setFrozen(v, true);
     }
   }
 
   void minisat::assert_clause(dimacs::clause cl) { 
-    Minisat::vec<Minisat::Lit> lits;
-    for(dimacs::literal lit : cl.literals) {
+    Minisat::vec<Minisat::Lit> &lits = _data->buffer;
+    lits.clear();
+    for(dimacs::literal lit : cl) {
       lits.push(Minisat::mkLit(lit.var, !lit.sign));
     }
 
@@ -66,10 +164,7 @@ namespace black_internal::minisat
   }
   
   tribool minisat::is_sat() {
-    bool result = _data->solver->solve();
-    _data->model_available = result;
-
-    return result;
+    return _data->solve(Minisat::vec<Minisat::Lit>{});
   }
 
   tribool 
@@ -79,10 +174,12 @@ namespace black_internal::minisat
       lits.push(Minisat::mkLit(lit.var, !lit.sign));
     }
 
-    bool result = _data->solver->solve(lits);
-    _data->model_available = result;
+    return _data->solve(lits);
+  }
 
-    return result;
+  bool minisat::failed(dimacs::literal lit) const {
+    // the conflict contains the negation of the failed assumptions
+    return _data->solver->conflict.has(~Minisat::mkLit(lit.var, !lit.sign));
   }
 
   tribool minisat::value(uint32_t v) const {
@@ -99,7 +196,22 @@ namespace black_internal::minisat
 
   void minisat::clear() {
     this->clear_vars();
-    _data = std::make_unique<_minisat_t>();
+    _data->reset();
+  }
+
+  void minisat::interrupt() {
+    std::lock_guard lock{_data->mutex};
+    _data->solver->interrupt();
+  }
+
+  bool minisat::set_option(
+    std::string_view key, black::sat::option_value const& value
+  ) {
+    if(!_data->apply(*_data->solver, key, value))
+      return false;
+
+    _data->options.push_back({std::string{key}, value});
+    return true;
   }
 
   std::optional<std::string> minisat::license() const
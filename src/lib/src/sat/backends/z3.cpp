@@ -37,6 +37,7 @@
 #include <string>
 #include <memory>
 #include <cstring>
+#include <utility>
 
 BLACK_REGISTER_SAT_BACKEND(z3, {
   black::sat::feature::smt, black::sat::feature::quantifiers
@@ -64,15 +65,36 @@ namespace black_internal::z3
     logic::scope xi;
 
     _z3_t(logic::scope const& _xi) 
-      : global_xi{chain(_xi)}, xi{chain(global_xi)} { }
+      : global_xi{chain(_xi)}, xi{chain(global_xi)}, caches(1) { }
 
     Z3_context context;
     Z3_solver solver;
     std::optional<Z3_model> model;
+    std::vector<formula> failed;
     bool solver_upgraded = false;
 
+    // the parameters given with set_option(), applied to every new solver,
+    // and the tactic the solver is made from, if given
+    Z3_params params;
+    std::optional<std::string> tactic;
+
     tsl::hopscotch_map<proposition, Z3_ast> props;
 
+    // Translations of the formulas and terms already seen. The variables
+    // bound by a quantifier may change the translation of its subformulas,
+    // so a new cache is pushed for each quantifier, and dropped at its end.
+    // There is no need to hold references to the cached ASTs, since they 
+    // live as long as the context (which is not reference-counted, and the
+    // solver is never pushed).
+    struct cache_t {
+      tsl::hopscotch_map<formula, Z3_ast> formulas;
+      tsl::hopscotch_map<term, Z3_ast> terms;
+    };
+    std::vector<cache_t> caches;
+
+    tsl::hopscotch_map<function, Z3_func_decl> functions;
+    tsl::hopscotch_map<relation, Z3_func_decl> relations;
+
     Z3_func_decl to_z3(function);
     Z3_func_decl to_z3(relation);
     Z3_ast to_z3(var_decl);
@@ -82,7 +104,17 @@ namespace black_internal::z3
     Z3_ast to_z3_inner(formula);
     Z3_ast to_z3_inner(term);
 
+    Z3_solver make_solver();
+    bool valid_params(Z3_solver s, Z3_params p);
     void upgrade_solver();
+    bool fetch_model();
+    bool tactic_exists(std::string const& name);
+    bool set_param(
+      Z3_params p, std::string const& key, black::sat::option_value const& v
+    );
+
+    template<typename F>
+    bool tolerant(F f);
   };
 
 
@@ -130,12 +162,47 @@ namespace black_internal::z3
     if(strcmp(errmsg, "canceled") == 0)
       return;
     
+    // an interrupt that comes right at the end of a check may leave it 
+    // without a model, see `_z3_t::fetch_model()`
+    if(e == Z3_INVALID_USAGE && strcmp(errmsg, "there is no current model") == 0)
+      return;
+    
     fprintf(stderr, "Z3 error %d: %s\n", (int)e, errmsg);
     std::abort(); // LCOV_EXCL_LINE
   }
 
   // end trick
 
+  //
+  // Calls `f`, with Z3 errors not aborting the process, and returns false if
+  // the last Z3 call made by `f` raised an error. Used where errors come from
+  // user input, i.e. the options.
+  //
+  template<typename F>
+  bool z3::_z3_t::tolerant(F f) {
+    Z3_set_error_handler(context, nullptr);
+    f();
+    bool ok = Z3_get_error_code(context) == Z3_OK;
+    Z3_set_error_handler(context, error_handler);
+
+    return ok;
+  }
+
+  // Returns false if there is no model even if the last check was 
+  // satisfiable, which happens if the check has been interrupted
+  bool z3::_z3_t::fetch_model() {
+    Z3_model m = Z3_solver_get_model(context, solver);
+    if(!m)
+      return false;
+    
+    Z3_model_inc_ref(context, m);
+    if(model)
+      Z3_model_dec_ref(context, *model);
+    model = m;
+
+    return true;
+  }
+
   z3::z3(class scope const& xi) 
     : _data{std::make_unique<_z3_t>(xi)} 
   { 
@@ -149,15 +216,135 @@ namespace black_internal::z3
 
     Z3_del_config(cfg);
 
-    _data->solver = Z3_mk_solver(_data->context);
-    Z3_solver_inc_ref(_data->context, _data->solver);
+    _data->params = Z3_mk_params(_data->context);
+    Z3_params_inc_ref(_data->context, _data->params);
+
+    _data->solver = _data->make_solver();
   }
 
   z3::~z3() {
     Z3_solver_dec_ref(_data->context, _data->solver);
+    Z3_params_dec_ref(_data->context, _data->params);
     Z3_del_context(_data->context);
   }
 
+  Z3_solver z3::_z3_t::make_solver() {
+    Z3_solver s = nullptr;
+    if(tactic) {
+      Z3_tactic t = Z3_mk_tactic(context, tactic->c_str());
+      Z3_tactic_inc_ref(context, t);
+      s = Z3_mk_solver_from_tactic(context, t);
+      Z3_tactic_dec_ref(context, t);
+    } else
+      s = Z3_mk_solver(context);
+    
+    Z3_solver_inc_ref(context, s);
+
+    return s;
+  }
+
+  // Z3 validates the parameters of a solver only when it is first used, so
+  // we check them beforehand
+  bool z3::_z3_t::valid_params(Z3_solver s, Z3_params p) {
+    Z3_param_descrs descrs = Z3_solver_get_param_descrs(context, s);
+    Z3_param_descrs_inc_ref(context, descrs);
+    bool ok = tolerant([&]{
+      Z3_params_validate(context, p, descrs);
+    });
+    Z3_param_descrs_dec_ref(context, descrs);
+
+    return ok;
+  }
+
+  bool z3::_z3_t::tactic_exists(std::string const& name) {
+    for(unsigned i = 0; i < Z3_get_num_tactics(context); ++i)
+      if(name == Z3_get_tactic_name(context, i))
+        return true;
+    return false;
+  }
+
+  // sets `key` in `p`, converting `v` to the type Z3 expects, if known
+  bool z3::_z3_t::set_param(
+    Z3_params p, std::string const& key, black::sat::option_value const& v
+  ) {
+    Z3_symbol sym = Z3_mk_string_symbol(context, key.c_str());
+
+    Z3_param_descrs descrs = Z3_solver_get_param_descrs(context, solver);
+    Z3_param_descrs_inc_ref(context, descrs);
+    Z3_param_kind kind = Z3_param_descrs_get_kind(context, descrs, sym);
+    Z3_param_descrs_dec_ref(context, descrs);
+
+    if(
+      auto d = black::sat::option_as<double>(v); 
+      d && (kind == Z3_PK_DOUBLE || std::holds_alternative<double>(v))
+    ) {
+      Z3_params_set_double(context, p, sym, *d);
+    } else if(auto i = black::sat::option_as<int64_t>(v); i) {
+      if(*i < 0 || *i > std::numeric_limits<unsigned>::max())
+        return false;
+      Z3_params_set_uint(context, p, sym, unsigned(*i));
+    } else if(auto b = black::sat::option_as<bool>(v); b) {
+      Z3_params_set_bool(context, p, sym, *b);
+    } else {
+      auto str = black::sat::option_as<std::string>(v);
+      black_assert(str.has_value());
+      Z3_params_set_symbol(
+        context, p, sym, Z3_mk_string_symbol(context, str->c_str())
+      );
+    }
+
+    return true;
+  }
+
+  //
+  // The `tactic` option makes the solver from the given Z3 tactic (formulas
+  // with quantifiers still switch to `qe` and `smt`). Any other option is 
+  // passed to the solver as a parameter, which Z3 validates.
+  //
+  bool z3::set_option(
+    std::string_view key, black::sat::option_value const& value
+  ) {
+    if(key == "tactic") {
+      auto name = black::sat::option_as<std::string>(value);
+      if(!name || !_data->tactic_exists(*name))
+        return false;
+
+      std::optional<std::string> old = std::exchange(_data->tactic, *name);
+      Z3_solver s = _data->make_solver();
+      
+      // the parameters given so far must be valid for the new solver
+      if(!_data->valid_params(s, _data->params)) {
+        Z3_solver_dec_ref(_data->context, s);
+        _data->tactic = old;
+        return false;
+      }
+
+      Z3_solver_set_params(_data->context, s, _data->params);
+      Z3_solver_dec_ref(_data->context, _data->solver);
+      _data->solver = s;
+      _data->solver_upgraded = false;
+      
+      return true;
+    }
+
+    // the parameter is first checked alone, so that a wrong one does not 
+    // pollute the others
+    std::string k{key};
+    Z3_params p = Z3_mk_params(_data->context);
+    Z3_params_inc_ref(_data->context, p);
+
+    bool ok = 
+      _data->set_param(p, k, value) && _data->valid_params(_data->solver, p);
+    if(ok) {
+      Z3_solver_set_params(_data->context, _data->solver, p);
+      _data->set_param(_data->params, k, value);
+    }
+    
+    Z3_params_dec_ref(_data->context, p);
+
+    return ok;
+  }
+
   void z3::assert_formula(formula f) { 
     // the call to to_ze() must stay on its own line before `Z3_solver_assert`
     // because it might update _data->solver
@@ -166,17 +353,37 @@ namespace black_internal::z3
     Z3_solver_assert(_data->context, _data->solver, ast);
   }
   
-  tribool z3::is_sat_with(formula f) {
-    Z3_ast asmptn = _data->to_z3(f);
+  tribool z3::is_sat_with(std::vector<formula> const& assumptions) {
+    std::vector<Z3_ast> asmptns;
+    for(formula f : assumptions)
+      asmptns.push_back(_data->to_z3(f));
     
-    Z3_lbool res = 
-      Z3_solver_check_assumptions(_data->context, _data->solver, 1, &asmptn);
+    Z3_lbool res = Z3_solver_check_assumptions(
+      _data->context, _data->solver, 
+      static_cast<unsigned>(asmptns.size()), asmptns.data()
+    );
 
-    if(res == Z3_L_TRUE) {
-      if(_data->model)
-        Z3_model_dec_ref(_data->context, *_data->model);
-      
-      _data->model = Z3_solver_get_model(_data->context, _data->solver);
+    if(res == Z3_L_TRUE && !_data->fetch_model())
+      res = Z3_L_UNDEF;
+
+    _data->failed.clear();
+    if(res == Z3_L_FALSE) {
+      Z3_ast_vector core = 
+        Z3_solver_get_unsat_core(_data->context, _data->solver);
+      Z3_ast_vector_inc_ref(_data->context, core);
+
+      unsigned size = Z3_ast_vector_size(_data->context, core);
+      for(size_t i = 0; i < asmptns.size(); ++i) {
+        for(unsigned j = 0; j < size; ++j) {
+          Z3_ast elem = Z3_ast_vector_get(_data->context, core, j);
+          if(Z3_is_eq_ast(_data->context, asmptns[i], elem)) {
+            _data->failed.push_back(assumptions[i]);
+            break;
+          }
+        }
+      }
+
+      Z3_ast_vector_dec_ref(_data->context, core);
     }
 
     return res == Z3_L_TRUE ? tribool{true} :
@@ -184,16 +391,15 @@ namespace black_internal::z3
            tribool::undef;
   }
 
+  std::vector<formula> z3::failed_assumptions() const {
+    return _data->failed;
+  }
+
   tribool z3::is_sat() {
     Z3_lbool res = Z3_solver_check(_data->context, _data->solver);
 
-    if(res == Z3_L_TRUE) {
-      if(_data->model)
-        Z3_model_dec_ref(_data->context, *_data->model);
-      
-      _data->model = Z3_solver_get_model(_data->context, _data->solver);
-      Z3_model_inc_ref(_data->context, *_data->model);
-    }
+    if(res == Z3_L_TRUE && !_data->fetch_model())
+      res = Z3_L_UNDEF;
 
     return res == Z3_L_TRUE ? tribool{true} :
            res == Z3_L_FALSE ? tribool{false} :
@@ -312,6 +518,11 @@ namespace black_internal::z3
     Z3_solver new_solver = Z3_mk_solver_from_tactic(context, qe_smt);
     Z3_solver_inc_ref(context, new_solver);
 
+    // the parameters valid for the original solver might not be valid for
+    // this one, in which case they are dropped
+    if(valid_params(new_solver, params))
+      Z3_solver_set_params(context, new_solver, params);
+
     Z3_ast_vector assertions = Z3_solver_get_assertions(context, solver);
 
     for(unsigned i = 0; i < Z3_ast_vector_size(context, assertions); ++i) {
@@ -386,6 +597,9 @@ namespace black_internal::z3
   }
 
   Z3_func_decl z3::_z3_t::to_z3(function f) {
+    if(auto it = functions.find(f); it != functions.end())
+      return it->second;
+
     Z3_symbol symbol = 
       Z3_mk_string_symbol(context, to_string(f.name()).c_str());
     
@@ -400,10 +614,17 @@ namespace black_internal::z3
       domain[i] = to_z3(signature->at(i)).sort;
     }
     
-    return Z3_mk_func_decl(context, symbol, arity, domain.get(), result);
+    Z3_func_decl decl = 
+      Z3_mk_func_decl(context, symbol, arity, domain.get(), result);
+    functions.insert({f, decl});
+
+    return decl;
   }
   
   Z3_func_decl z3::_z3_t::to_z3(relation r) {
+    if(auto it = relations.find(r); it != relations.end())
+      return it->second;
+
     Z3_symbol symbol = 
       Z3_mk_string_symbol(context, to_string(r.name()).c_str());
     
@@ -418,7 +639,11 @@ namespace black_internal::z3
       domain[i] = to_z3(signature->at(i)).sort;
     }
     
-    return Z3_mk_func_decl(context, symbol, arity, domain.get(), bool_s);
+    Z3_func_decl decl = 
+      Z3_mk_func_decl(context, symbol, arity, domain.get(), bool_s);
+    relations.insert({r, decl});
+
+    return decl;
   }
 
   Z3_ast z3::_z3_t::to_z3(var_decl decl) {
@@ -432,6 +657,18 @@ namespace black_internal::z3
   }
 
   Z3_ast z3::_z3_t::to_z3(formula f) 
+  {
+    if(auto it = caches.back().formulas.find(f); 
+       it != caches.back().formulas.end())
+      return it->second;
+
+    Z3_ast ast = to_z3_inner(f);
+    caches.back().formulas.insert({f, ast});
+
+    return ast;
+  }
+
+  Z3_ast z3::_z3_t::to_z3_inner(formula f) 
   {
     return f.match(
       [&](boolean b) {
@@ -498,10 +735,14 @@ namespace black_internal::z3
           xi.set_data(decl.variable(), var);
           z3_apps.push_back(Z3_to_app(context, var));
         }
+
+        caches.emplace_back();
+        Z3_ast matrix = to_z3(q.matrix());
+        caches.pop_back();
         
         auto result = Z3_mk_quantifier_const(
           context, forall, 0, unsigned(z3_apps.size()), 
-          z3_apps.data(), 0, nullptr, to_z3(q.matrix())
+          z3_apps.data(), 0, nullptr, matrix
         );
 
         return result;
@@ -552,6 +793,16 @@ namespace black_internal::z3
   }
 
   Z3_ast z3::_z3_t::to_z3(term t) {
+    if(auto it = caches.back().terms.find(t); it != caches.back().terms.end())
+      return it->second;
+
+    Z3_ast ast = to_z3_inner(t);
+    caches.back().terms.insert({t, ast});
+
+    return ast;
+  }
+
+  Z3_ast z3::_z3_t::to_z3_inner(term t) {
     return t.match(
       [&](constant, auto n) {
         return n.match(
@@ -31,19 +31,103 @@ namespace black_internal::dimacs
   struct solver::_solver_t {
     tsl::hopscotch_map<proposition, uint32_t> vars;
 
+    // number of allocated variables, including the anonymous ones
+    uint32_t nvars = 0;
+
+    // assumptions of the last call to is_sat_with() needed to prove 
+    // unsatisfiability, if it returned false
+    std::vector<formula<FO>> failed;
+
+    // the CNF conversion lives as long as the solver, so that subformulas 
+    // shared between different assertions are only encoded once. The
+    // fresh literals are never exposed, so only the needed directions of
+    // their definitions are emitted
+    cnf::tseitin_encoder tseitin{cnf::tseitin_mode::polarity_aware};
+
+    //
+    // The step template, if set. Its clauses use variables numbered as
+    // follows: the i-th slot at the current step is i, the same at the next
+    // step is `slots.size() + i`, and the j-th Tseitin variable is
+    // `2 * slots.size() + j`.
+    //
+    struct step_template_t {
+      step_fn step;
+      shift_fn shift;
+
+      // the propositions of the template, at step 0, and their indexes
+      std::vector<proposition> slots;
+      tsl::hopscotch_map<proposition, uint32_t> indexes;
+
+      // the literals of all the clauses, and where each clause ends
+      std::vector<literal> literals;
+      std::vector<size_t> ends;
+
+      // number of Tseitin variables of each copy
+      uint32_t aux = 0;
+
+      // the variables of the slots at each step allocated so far
+      std::vector<std::vector<uint32_t>> steps;
+    };
+    std::optional<step_template_t> templ;
+
+    // buffer where clauses are translated before being asserted
+    std::vector<literal> buffer;
+
     // retrieve the var number or add it if the proposition is not registered
     uint32_t var(proposition a) {
       if(auto it = vars.find(a); it != vars.end())
         return it->second;
 
-      black_assert(vars.size() < std::numeric_limits<uint32_t>::max());
-      
-      // the new var is size() + 1 because 0 is never assigned to any var
-      uint32_t v = static_cast<uint32_t>(vars.size()) + 1;
+      if(auto v = template_var(a, true); v)
+        return *v;
+
+      uint32_t v = fresh_var();
       vars.insert({a, v});
       
       return v;
     }
+
+    // allocate a new variable not associated to any proposition
+    uint32_t fresh_var() {
+      black_assert(nvars < std::numeric_limits<uint32_t>::max());
+
+      // the first var is 1 because 0 is never assigned to any var
+      return ++nvars;
+    }
+
+    // the var of a proposition of the template at any step, allocating the 
+    // step if `allocate` is true
+    std::optional<uint32_t> template_var(proposition a, bool allocate) {
+      if(!templ)
+        return {};
+
+      std::optional<size_t> k = templ->step(a);
+      if(!k)
+        return {};
+      
+      auto it = templ->indexes.find(templ->shift(a, 0));
+      if(it == templ->indexes.end())
+        return {};
+
+      if(*k >= templ->steps.size()) {
+        if(!allocate)
+          return {};
+        allocate_steps(*k);
+      }
+      
+      return templ->steps[*k][it->second];
+    }
+
+    // allocates the variables of the slots of the template up to step `k`
+    void allocate_steps(size_t k) {
+      while(templ->steps.size() <= k) {
+        std::vector<uint32_t> step;
+        step.reserve(templ->slots.size());
+        for(size_t i = 0; i < templ->slots.size(); ++i)
+          step.push_back(fresh_var());
+        templ->steps.push_back(std::move(step));
+      }
+    }
   };
 
   solver::solver() : 
@@ -58,51 +142,296 @@ namespace black_internal::dimacs
     auto pf = f.to<formula<propositional>>();
     black_assert(pf.has_value());
     // conversion of the formula to CNF
-    cnf::cnf c = cnf::to_cnf(*pf);
+    cnf::cnf c = _data->tseitin.to_cnf(*pf);
 
+    assert_cnf(c, {});
+  }
+
+  void solver::assert_cnf(cnf::cnf const& c, std::optional<literal> guard)
+  {
     // census of new variables
-    size_t old_size = _data->vars.size();
-    for(black::clause cl : c.clauses) {
-      for(black::literal lit : cl.literals) {
-        _data->var(lit.prop);
-      }
-    }
-    
+    size_t old_size = _data->nvars;
+    for(black::literal lit : c.literals())
+      _data->var(lit.prop);
+
     // allocate the new variables
-    size_t new_size = _data->vars.size();
+    size_t new_size = _data->nvars;
     if(new_size > old_size)
       this->new_vars(new_size - old_size);
 
     // assert the clauses
-    for(black::clause cl : c.clauses) {
-      dimacs::clause dcl;
-      for(black::literal lit : cl.literals) {
-        dcl.literals.push_back({ lit.sign, _data->var(lit.prop) });
-      }
+    std::vector<literal> &buffer = _data->buffer;
+    for(std::span<black::literal const> cl : c) {
+      buffer.clear();
+      for(black::literal lit : cl)
+        buffer.push_back({ lit.sign, _data->var(lit.prop) });
+      if(guard)
+        buffer.push_back(*guard);
 
       // assert the clause
-      this->assert_clause(dcl);
+      this->assert_clause(buffer);
+    }
+  }
+
+  bool solver::set_step_template(
+    formula<FO> f, step_fn step, shift_fn shift
+  ) {
+    auto pf = f.to<formula<propositional>>();
+    black_assert(pf.has_value());
+    
+    // a standalone conversion, because the Tseitin variables must not be 
+    // shared with other assertions
+    cnf::cnf c = cnf::to_cnf(*pf, cnf::tseitin_mode::polarity_aware);
+
+    _solver_t::step_template_t templ;
+    templ.step = std::move(step);
+    templ.shift = std::move(shift);
+
+    tsl::hopscotch_map<proposition, uint32_t> auxs;
+    for(black::literal lit : c.literals()) {
+      if(auto k = templ.step(lit.prop); k) {
+        if(*k > 1)
+          return false;
+        proposition slot = templ.shift(lit.prop, 0);
+        if(!templ.indexes.contains(slot)) {
+          templ.indexes.insert({slot, uint32_t(templ.slots.size())});
+          templ.slots.push_back(slot);
+        }
+      } else if(lit.prop.name().is<formula<propositional>>()) {
+        auxs.insert({lit.prop, uint32_t(auxs.size())});
+      } else
+        return false;
+    }
+
+    uint32_t nslots = uint32_t(templ.slots.size());
+    templ.aux = uint32_t(auxs.size());
+    templ.literals.reserve(c.literals().size());
+    templ.ends.reserve(c.size());
+    for(std::span<black::literal const> cl : c) {
+      for(black::literal lit : cl) {
+        uint32_t v = 0;
+        if(auto k = templ.step(lit.prop); k)
+          v = templ.indexes.at(templ.shift(lit.prop, 0)) + uint32_t(*k) * nslots;
+        else
+          v = 2 * nslots + auxs.at(lit.prop);
+        templ.literals.push_back({lit.sign, v});
+      }
+      templ.ends.push_back(templ.literals.size());
+    }
+
+    // propositions already asserted keep their variables
+    size_t old_size = _data->nvars;
+    std::vector<uint32_t> first;
+    for(proposition slot : templ.slots)
+      first.push_back(_data->var(slot));
+    templ.steps.push_back(std::move(first));
+
+    std::vector<std::tuple<size_t, uint32_t, uint32_t>> taken;
+    for(auto [a, v] : _data->vars) {
+      auto k = templ.step(a);
+      if(!k || *k == 0)
+        continue;
+      if(auto it = templ.indexes.find(templ.shift(a, 0)); 
+         it != templ.indexes.end())
+        taken.push_back({*k, it->second, v});
+    }
+
+    _data->templ = std::move(templ);
+    for(auto [k, i, v] : taken) {
+      _data->allocate_steps(k);
+      _data->templ->steps[k][i] = v;
+    }
+
+    if(_data->nvars > old_size)
+      this->new_vars(_data->nvars - old_size);
+
+    return true;
+  }
+
+  void solver::assert_step(size_t k) {
+    black_assert(_data->templ.has_value());
+    black_assert(k > 0);
+
+    auto &templ = *_data->templ;
+    size_t old_size = _data->nvars;
+    _data->allocate_steps(k);
+
+    // the Tseitin variables of this copy are `base + 1` onwards
+    black_assert(
+      _data->nvars <= std::numeric_limits<uint32_t>::max() - templ.aux
+    );
+    uint32_t base = _data->nvars;
+    _data->nvars += templ.aux;
+
+    this->new_vars(_data->nvars - old_size);
+
+    uint32_t nslots = uint32_t(templ.slots.size());
+    std::vector<uint32_t> const& current = templ.steps[k - 1];
+    std::vector<uint32_t> const& next = templ.steps[k];
+    std::vector<literal> &buffer = _data->buffer;
+    size_t begin = 0;
+    for(size_t end : templ.ends) {
+      buffer.clear();
+      for(size_t i = begin; i < end; ++i) {
+        literal lit = templ.literals[i];
+        if(lit.var < nslots)
+          lit.var = current[lit.var];
+        else if(lit.var < 2 * nslots)
+          lit.var = next[lit.var - nslots];
+        else
+          lit.var = base + 1 + (lit.var - 2 * nslots);
+        buffer.push_back(lit);
+      }
+      this->assert_clause(buffer);
+      begin = end;
     }
   }
 
-  // TODO: optimize corner cases (e.g. if assumption is already a literal)
-  tribool solver::is_sat_with(logic::formula<logic::FO> assumption) 
-  { 
-    proposition fresh = assumption.sigma()->proposition(assumption);
+  std::optional<uint32_t> solver::template_slot(proposition p) const {
+    black_assert(_data->templ.has_value());
+
+    auto it = _data->templ->indexes.find(p);
+    if(it == _data->templ->indexes.end())
+      return {};
+    return it->second;
+  }
+
+  uint32_t solver::template_var(uint32_t slot, size_t k) {
+    black_assert(_data->templ.has_value());
+    black_assert(slot < _data->templ->slots.size());
+
+    size_t old_size = _data->nvars;
+    _data->allocate_steps(k);
+    if(_data->nvars > old_size)
+      this->new_vars(_data->nvars - old_size);
 
-    this->assert_formula(iff(fresh, assumption));
+    return _data->templ->steps[k][slot];
+  }
 
-    return this->is_sat_with({{true, _data->var(fresh)}});
+  uint32_t solver::fresh_var() {
+    uint32_t v = _data->fresh_var();
+    this->new_vars(1);
+    return v;
+  }
+
+  tribool 
+  solver::is_sat_with(std::vector<formula<FO>> const& assumptions) 
+  {
+    std::vector<literal> lits;
+    std::vector<formula<propositional>> complex;
+
+    // assumptions given as literals, with their literal
+    std::vector<std::pair<formula<FO>, literal>> given;
+
+    // literals are assumed directly, other formulas need a definition
+    size_t old_size = _data->nvars;
+    for(formula<FO> a : assumptions) {
+      auto pa = a.to<formula<propositional>>();
+      black_assert(pa.has_value());
+
+      std::optional<literal> lit;
+      if(auto p = pa->to<proposition>(); p)
+        lit = literal{true, _data->var(*p)};
+      else if(
+        auto n = pa->to<negation<propositional>>(); 
+        n && n->argument().is<proposition>()
+      )
+        lit = literal{false, _data->var(*n->argument().to<proposition>())};
+      
+      if(lit) {
+        lits.push_back(*lit);
+        given.push_back({a, *lit});
+      } else
+        complex.push_back(*pa);
+    }
+
+    if(_data->nvars > old_size)
+      this->new_vars(_data->nvars - old_size);
+
+    _data->failed.clear();
+
+    if(complex.empty()) {
+      tribool result = this->is_sat_with(lits);
+      if(result == false)
+        collect_failed(given, {}, {});
+      return result;
+    }
+
+    // The definitions of the other assumptions are guarded by a fresh
+    // variable, which is assumed for this call and then permanently falsified,
+    // so that the guarded clauses become satisfied and are retracted.
+    uint32_t guard = _data->fresh_var();
+    this->new_vars(1);
+
+    for(formula<propositional> a : complex)
+      assert_cnf(_data->tseitin.to_transient_cnf(a), literal{false, guard});
+
+    lits.push_back({true, guard});
+    tribool result = this->is_sat_with(lits);
+
+    // the failed assumptions must be queried before adding other clauses
+    if(result == false)
+      collect_failed(given, complex, literal{true, guard});
+
+    this->assert_clause({literal{false, guard}});
+
+    return result;
+  }
+
+  void solver::collect_failed(
+    std::vector<std::pair<formula<FO>, literal>> const& given,
+    std::vector<formula<propositional>> const& complex,
+    std::optional<literal> guard
+  ) {
+    for(auto [a, lit] : given)
+      if(failed(lit))
+        _data->failed.push_back(a);
+
+    if(guard && failed(*guard))
+      for(formula<propositional> a : complex)
+        _data->failed.push_back(a);
+  }
+
+  std::vector<formula<FO>> solver::failed_assumptions() const {
+    return _data->failed;
   }
 
   tribool solver::value(proposition a) const {
     auto it = _data->vars.find(a);
-    if(it == _data->vars.end())
-      return tribool::undef;
+    if(it != _data->vars.end())
+      return this->value(it->second);
+
+    if(auto v = _data->template_var(a, false); v)
+      return this->value(*v);
+
+    return tribool::undef;
+  }
+
+  bool solver::for_each_value(
+    std::function<void(logic::proposition, tribool)> const& f
+  ) const {
+    for(auto [a, var] : _data->vars)
+      f(a, this->value(var));
+
+    return true;
+  }
+
+  std::span<proposition const> solver::template_slots() const {
+    if(!_data->templ)
+      return {};
+    return _data->templ->slots;
+  }
 
-    uint32_t prop = it->second;
+  void solver::for_each_template_value(
+    std::function<void(uint32_t, size_t, tribool)> const& f
+  ) const {
+    if(!_data->templ)
+      return;
 
-    return this->value(prop);
+    auto const& steps = _data->templ->steps;
+    for(size_t k = 1; k < steps.size(); ++k)
+      for(uint32_t i = 0; i < steps[k].size(); ++i)
+        f(i, k, this->value(steps[k][i]));
   }
 
   tribool solver::value(logic::atom<logic::FO>) const { // LCOV_EXCL_LINE
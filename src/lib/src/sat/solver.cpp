@@ -25,6 +25,11 @@
 #include <black/sat/solver.hpp>
 
 #include <tsl/hopscotch_map.h>
+#include <fmt/format.h>
+
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
 
 namespace black::sat
 {
@@ -83,6 +88,40 @@ namespace black::sat
     return std::find(features.begin(), features.end(), f) != features.end();
   }
 
+  option_value parse_option_value(std::string_view str) {
+    if(str == "true")
+      return true;
+    if(str == "false")
+      return false;
+
+    int64_t i = 0;
+    auto [iend, ierr] = std::from_chars(str.data(), str.data() + str.size(), i);
+    if(ierr == std::errc{} && iend == str.data() + str.size())
+      return i;
+
+    // std::from_chars() for floating-point numbers is not available 
+    // everywhere yet
+    std::string s{str};
+    char *dend = nullptr;
+    double d = std::strtod(s.c_str(), &dend);
+    if(!s.empty() && !std::isspace(s.front()) && dend == s.c_str() + s.size())
+      return d;
+
+    return s;
+  }
+
+  std::string to_string(option_value const& value) {
+    return std::visit([](auto v) -> std::string {
+      using T = decltype(v);
+      if constexpr(std::is_same_v<T, bool>)
+        return v ? "true" : "false";
+      else if constexpr(std::is_same_v<T, std::string>)
+        return v;
+      else
+        return fmt::format("{}", v);
+    }, value);
+  }
+
   std::vector<std::string_view> solver::backends() {
     using namespace black::sat::internal;
 
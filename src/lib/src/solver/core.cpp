@@ -27,10 +27,17 @@
 #include <black/logic/logic.hpp>
 #include <black/logic/prettyprint.hpp>
 #include <black/solver/solver.hpp>
+#include <black/solver/encoding.hpp>
+#include <black/sat/solver.hpp>
+#include <black/support/config.hpp>
 
 #include <tsl/hopscotch_map.h>
 #include <tsl/hopscotch_set.h>
 
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
 namespace black_internal::core {
 
   struct K_data_t {
@@ -89,53 +96,6 @@ namespace black_internal::core {
     return {ks, next_placeholder};
   }
 
-  static
-  std::vector<std::vector<formula>>
-  group_by_K(formula f, tsl::hopscotch_map<formula, K_data_t> ks) {
-    std::vector<std::vector<formula>> groups(ks[f].size + 1);
-
-    for(auto [subf, k] : ks) {
-      size_t K = k.size * k.n;
-      black_assert(K < groups.size());
-      groups[K].push_back(subf);
-    }
-
-    std::reverse(begin(groups), end(groups));
-
-    return groups;
-  }
-
-  static size_t increment(std::vector<bool> &v) {
-    size_t pos = 0;
-    
-    while(pos < v.size() && v[pos]) {
-      v[pos] = false;
-      ++pos;
-    }
-    if(pos < v.size())
-      v[pos] = true;
-
-    return pos;
-  }
-
-  static std::vector<std::vector<bool>> build_bitsets(size_t size) {
-    std::vector<std::vector<bool>> result;
-    
-    std::vector<bool> v(size);
-    while(increment(v) != size) {
-      result.push_back(v);
-    }
-
-    std::sort(begin(result), end(result), [](auto const& a, auto const& b) {
-      auto m = std::count_if(begin(a), end(a), [](bool x) { return x; });
-      auto n = std::count_if(begin(b), end(b), [](bool x) { return x; });
-
-      return m > n;
-    });
-
-    return result;
-  }
-
   static 
   formula replace_impl(
     formula f, tsl::hopscotch_set<formula> const& dontcares,
@@ -161,30 +121,15 @@ namespace black_internal::core {
         );
       },
       [&](binary b, formula left, formula right) {
-        return binary(
-          b.node_type(), 
-          replace_impl(left, dontcares, indexes, next_index), 
-          replace_impl(right, dontcares, indexes, next_index)
-        );
+        // placeholders are numbered from left to right
+        formula l = replace_impl(left, dontcares, indexes, next_index);
+        formula r = replace_impl(right, dontcares, indexes, next_index);
+        return binary(b.node_type(), l, r);
       },
       [](otherwise) -> formula { black_unreachable(); } // LCOV_EXCL_LINE
     );
   }
 
-  static
-  tsl::hopscotch_set<formula> build_subset(
-    std::vector<formula> const& universe, std::vector<bool> const&bitset
-  ) {
-    black_assert(universe.size() == bitset.size());
-    tsl::hopscotch_set<formula> subset;
-    for(size_t i = 0; i < bitset.size(); ++i) {
-      if(bitset[i])
-        subset.insert(universe[i]);
-    }
-
-    return subset;
-  }
-
   static 
   formula replace(
     formula f, tsl::hopscotch_set<formula> const&dontcares,
@@ -195,6 +140,39 @@ namespace black_internal::core {
     return replace_impl(f, dontcares, indexes, next_index);
   }
 
+  // collects the subformulas of `f` that survive the replacement of the 
+  // given dontcares
+  static
+  void surviving_impl(
+    formula f, tsl::hopscotch_set<formula> const& dontcares,
+    tsl::hopscotch_set<formula> &result
+  ) {
+    if(dontcares.contains(f) || result.contains(f))
+      return;
+    result.insert(f);
+
+    f.match(
+      [](boolean) { },
+      [](proposition) { },
+      [&](unary, formula arg) {
+        surviving_impl(arg, dontcares, result);
+      },
+      [&](binary, formula left, formula right) {
+        surviving_impl(left, dontcares, result);
+        surviving_impl(right, dontcares, result);
+      },
+      [](otherwise) { black_unreachable(); } // LCOV_EXCL_LINE
+    );
+  }
+
+  static
+  tsl::hopscotch_set<formula> 
+  surviving(formula f, tsl::hopscotch_set<formula> const& dontcares) {
+    tsl::hopscotch_set<formula> result;
+    surviving_impl(f, dontcares, result);
+    return result;
+  }
+
   static
   bool check_replacements_impl(
     formula f, tsl::hopscotch_map<size_t, formula> &formulas
@@ -227,26 +205,324 @@ namespace black_internal::core {
     return check_replacements_impl(f, formulas);
   }
 
-  formula unsat_core(scope const& xi, formula f, bool finite) {
+  //
+  // The core is extracted from a single incremental encoding of a guarded
+  // version of the formula, where each candidate subformula `f` is replaced
+  // by `(a & f) | (!a & c)`, with `a` a fresh activation proposition and `c`
+  // the placeholder of `f`. Assuming `a` at each time step gives back `f`,
+  // while assuming `!a` makes `f` equivalent to its placeholder. Hence,
+  // checking a set of candidates only requires a different set of 
+  // assumptions, and the failed assumptions of an unsatisfiable check 
+  // suggest which candidates are actually needed.
+  //
+  // The requests of disabled candidates are still encoded, so the 
+  // activations are also given to the encoder as guards, which drop those 
+  // requests from the LOOP and PRUNE conditions. Otherwise, they would make
+  // the PRUNE much weaker than on the formula with the placeholders.
+  //
+  class core_engine 
+  {
+  public:
+    core_engine(
+      scope const& xi, formula f, bool finite, 
+      std::vector<formula> const& candidates, size_t next_placeholder
+    ) : _xi{chain(xi)}, 
+        _enc{
+          guard(f, candidates, next_placeholder), _xi, finite, 
+          solver::loop_encoding::pairwise, _activations
+        },
+        _sat{black::sat::solver::get_solver(BLACK_DEFAULT_BACKEND, _xi)} { }
+
+    // Runs the main algorithm on the guarded formula with only the 
+    // candidates in `active` enabled, up to bound `max_k`. If the result is
+    // unsatisfiable, `active` may be restricted to fewer candidates, still 
+    // unsatisfiable. Returns `tribool::undef` if `max_k` is reached.
+    tribool is_sat(std::vector<size_t> &active, size_t max_k);
+
+    // The bound reached by the last check
+    size_t last_bound() const { return _last_bound; }
+
+  private:
+    formula guard(
+      formula f, std::vector<formula> const& candidates, 
+      size_t next_placeholder
+    );
+
+    formula guard_impl(
+      formula f, tsl::hopscotch_map<formula, size_t> const& indexes,
+      tsl::hopscotch_map<formula, formula> &memo, size_t next_placeholder
+    );
+
+    // a single run of the main algorithm, as described for is_sat()
+    tribool check(std::vector<size_t> const& active, size_t max_k);
+
+    std::vector<logic::formula<logic::FO>> 
+    activations(std::vector<size_t> const& active, size_t k);
+
+    // the candidates of `active` found in the failed assumptions of the last
+    // check
+    std::vector<size_t> failed(std::vector<size_t> const& active);
+
+    // activation propositions of the candidates. Declared first because
+    // they are filled by `guard()` when initializing `_enc`
+    std::vector<proposition> _activations;
+    
+    // candidate of each stepped activation proposition
+    tsl::hopscotch_map<proposition, size_t> _stepped;
+
+    scope _xi;
+    black_internal::encoder::encoder _enc;
+    std::unique_ptr<black::sat::solver> _sat;
+
+    // number of unravelings and prunes asserted so far
+    size_t _unravelings = 0;
+    size_t _prunes = 0;
+
+    size_t _last_bound = 0;
+  };
+
+  formula core_engine::guard(
+    formula f, std::vector<formula> const& candidates, 
+    size_t next_placeholder
+  ) {
+    using namespace std::literals;
+
+    tsl::hopscotch_map<formula, size_t> indexes;
+    for(size_t i = 0; i < candidates.size(); ++i) {
+      indexes.insert({candidates[i], i});
+      _activations.push_back(
+        f.sigma()->proposition(std::tuple{"_core_activation"sv, i})
+      );
+    }
+
+    tsl::hopscotch_map<formula, formula> memo;
+    return guard_impl(f, indexes, memo, next_placeholder);
+  }
+
+  formula core_engine::guard_impl(
+    formula f, tsl::hopscotch_map<formula, size_t> const& indexes,
+    tsl::hopscotch_map<formula, formula> &memo, size_t next_placeholder
+  ) {
+    if(auto it = memo.find(f); it != memo.end())
+      return it->second;
+
+    formula result = f.match(
+      [&](boolean) { return f; },
+      [&](proposition) { return f; },
+      [&](unary u, formula arg) {
+        return unary(
+          u.node_type(), guard_impl(arg, indexes, memo, next_placeholder)
+        );
+      },
+      [&](binary b, formula left, formula right) {
+        return binary(
+          b.node_type(), 
+          guard_impl(left, indexes, memo, next_placeholder), 
+          guard_impl(right, indexes, memo, next_placeholder)
+        );
+      },
+      [](otherwise) -> formula { black_unreachable(); } // LCOV_EXCL_LINE
+    );
+
+    if(auto it = indexes.find(f); it != indexes.end()) {
+      proposition a = _activations[it->second];
+      proposition c = f.sigma()->proposition(
+        core_placeholder_t{next_placeholder + it->second, f}
+      );
+      result = (a && result) || (!a && c);
+    }
+
+    memo.insert({f, result});
+    return result;
+  }
+
+  std::vector<logic::formula<logic::FO>> 
+  core_engine::activations(std::vector<size_t> const& active, size_t k) {
+    using black_internal::encoder::encoder;
+
+    std::vector<bool> enabled(_activations.size(), false);
+    for(size_t i : active)
+      enabled[i] = true;
+
+    std::vector<logic::formula<logic::FO>> result;
+    for(size_t i = 0; i < _activations.size(); ++i) {
+      for(size_t t = 0; t <= k; ++t) {
+        proposition a = encoder::stepped(_activations[i], t);
+        if(enabled[i]) {
+          _stepped.insert({a, i});
+          result.push_back(a);
+        } else
+          result.push_back(!a);
+      }
+    }
+
+    return result;
+  }
+
+  std::vector<size_t> core_engine::failed(std::vector<size_t> const& active) 
+  {
+    tsl::hopscotch_set<size_t> found;
+    for(logic::formula<logic::FO> a : _sat->failed_assumptions())
+      if(auto p = a.to<proposition>(); p)
+        if(auto it = _stepped.find(*p); it != _stepped.end())
+          found.insert(it->second);
+
+    std::vector<size_t> result = active;
+    std::erase_if(result, [&](size_t i) { return !found.contains(i); });
+    return result;
+  }
+
+  //
+  // A refutation at bound k also relies on the checks of EMPTY and LOOP at 
+  // the smaller bounds, which do not show up in the failed assumptions of
+  // the last check. Hence the candidates found there are only a guess, 
+  // taken if they are refuted on their own.
+  //
+  tribool core_engine::is_sat(std::vector<size_t> &active, size_t max_k) {
+    tribool res = check(active, max_k);
+    
+    while(res == false) {
+      std::vector<size_t> guess = failed(active);
+      if(guess.size() == active.size() || check(guess, max_k) != false)
+        break;
+      active = std::move(guess);
+    }
+
+    return res;
+  }
+
+  tribool core_engine::check(std::vector<size_t> const& active, size_t max_k) 
+  {
+    using namespace std::literals;
+
+    // The unravelings and the prunes are asserted only once and shared by 
+    // all the checks. However, a check at bound `k` must not see those of 
+    // greater bounds, asserted by previous checks, otherwise the prunes 
+    // would cut models found at smaller bounds. So each one is guarded by
+    // its own proposition, assumed only up to the current bound.
+    alphabet *sigma = _enc.get_formula().sigma();
+    auto unrav_guard = [&](size_t k) {
+      return sigma->proposition(std::tuple{"_core_unrav"sv, k});
+    };
+    auto prune_guard = [&](size_t k) {
+      return sigma->proposition(std::tuple{"_core_prune"sv, k});
+    };
+
+    std::vector<logic::formula<logic::FO>> guards;
+    for(size_t k = 0; k <= max_k; ++k) {
+      _last_bound = k;
+      if(k == _unravelings) {
+        _sat->assert_formula(implies(
+          unrav_guard(k), _enc.k_unraveling(k) && _enc.loop_axioms(k)
+        ));
+        _unravelings++;
+      }
+      guards.push_back(unrav_guard(k));
+
+      std::vector<logic::formula<logic::FO>> assumptions = 
+        activations(active, k);
+      assumptions.insert(assumptions.end(), guards.begin(), guards.end());
+      
+      if(_sat->is_sat_with(assumptions) == false)
+        return false;
+
+      assumptions.push_back(_enc.k_empty(k) || _enc.k_loop(k));
+      if(_sat->is_sat_with(assumptions) == true)
+        return true;
+      assumptions.pop_back();
+
+      if(k == _prunes) {
+        _sat->assert_formula(implies(prune_guard(k), !_enc.prune(k)));
+        _prunes++;
+      }
+      guards.push_back(prune_guard(k));
+      assumptions.push_back(prune_guard(k));
+
+      if(_sat->is_sat_with(assumptions) == false)
+        return false;
+    }
+
+    return tribool::undef;
+  }
+
+  // Bound at which a trial of the minimization is given up, keeping its 
+  // candidate, given the bound `k` at which the whole formula is refuted,
+  // unless a minimal core is asked for. Replacing a candidate can make the
+  // refutation much longer, and a few such trials would otherwise take most
+  // of the time.
+  static size_t trial_bound(size_t k) {
+    return 2 * k + 8;
+  }
+
+  formula unsat_core(scope const& xi, formula f, bool finite, bool minimal) {
     auto [ks, next_placeholder] = traverse(f);
-    auto groups = group_by_K(f, ks);
 
-    for(auto &group : groups) {
-      auto bitsets = build_bitsets(group.size());
+    // candidates are tried from the biggest ones, where the size of a 
+    // subformula counts all its occurrences
+    std::vector<formula> candidates;
+    for(auto [subf, k] : ks)
+      candidates.push_back(subf);
+    
+    auto K = [&](formula g) { return ks[g].size * ks[g].n; };
+    std::sort(begin(candidates), end(candidates), [&](formula a, formula b) {
+      if(K(a) != K(b))
+        return K(a) > K(b);
+      return ks[a].size > ks[b].size;
+    });
 
-      for(auto &bitset : bitsets) 
-      { 
-        auto subset = build_subset(group, bitset);
-        formula candidate = replace(f, subset, next_placeholder);
+    core_engine engine{xi, f, finite, candidates, next_placeholder};
+
+    std::vector<size_t> active(candidates.size());
+    std::iota(begin(active), end(active), 0);
+
+    auto dontcares = [&](std::vector<size_t> const& enabled) {
+      std::vector<bool> kept(candidates.size(), false);
+      for(size_t j : enabled)
+        kept[j] = true;
+
+      tsl::hopscotch_set<formula> result;
+      for(size_t j = 0; j < candidates.size(); ++j)
+        if(!kept[j])
+          result.insert(candidates[j]);
+      return result;
+    };
+
+    if(engine.is_sat(active, std::numeric_limits<size_t>::max()) == true)
+      return f;
+
+    size_t max_k = minimal ? 
+      std::numeric_limits<size_t>::max() : trial_bound(engine.last_bound());
+
+    // deletion-based minimization, where each unsatisfiable check also 
+    // drops the candidates not needed for the proof, and those whose 
+    // subformulas are replaced together with other candidates. Candidates
+    // whose trials reach the bound are kept, which cannot happen when a 
+    // minimal core is asked for, since the trials are then not bounded.
+    size_t i = 0;
+    while(i < active.size()) {
+      std::vector<size_t> trial = active;
+      trial.erase(begin(trial) + ptrdiff_t(i));
+
+      if(engine.is_sat(trial, max_k) == false) {
+        auto remaining = surviving(f, dontcares(trial));
+        std::erase_if(trial, [&](size_t j) {
+          return !remaining.contains(candidates[j]);
+        });
+        active = std::move(trial);
+      } else
+        ++i;
+    }
 
-        black::solver slv;
-        
-        if(slv.solve(xi, candidate, finite) == false)
-          return unsat_core(xi, candidate, finite);
-      }      
+    if(active.size() == candidates.size()) {
+      black_assert(check_replacements(f));
+      return f;
     }
-    black_assert(check_replacements(f));
-    return f;
+
+    // the placeholders just introduced may now be part of bigger 
+    // subformulas that can be replaced as a whole
+    return unsat_core(
+      xi, replace(f, dontcares(active), next_placeholder), finite, minimal
+    );
   }
 
 }
@@ -0,0 +1,177 @@
+//
+// BLACK - Bounded Ltl sAtisfiability ChecKer
+//
+// (C) 2019 Luca Geatti
+// (C) 2019 Nicola Gigante
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <black/solver/deadline.hpp>
+
+#include <tsl/hopscotch_map.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace black_internal::solver {
+
+  struct deadline_service::_service_t
+  {
+    struct entry_t {
+      clock::time_point deadline;
+      uint64_t id;
+
+      // reversed, so that the heap algorithms give a min-heap
+      bool operator<(entry_t const& other) const {
+        return deadline > other.deadline;
+      }
+    };
+
+    std::mutex mutex;
+    std::condition_variable wakeup; // wakes up the timer thread
+    std::condition_variable done; // signals the end of a callback
+
+    // pending deadlines. Cancelled ones are removed from `callbacks` right
+    // away but stay in the heap until they reach the top, or until the heap
+    // is compacted
+    std::vector<entry_t> heap;
+    tsl::hopscotch_map<uint64_t, std::function<void()>> callbacks;
+
+    uint64_t next_id = 1;
+    uint64_t running = 0; // id of the callback being called, if any
+    bool stop = false;
+    std::thread thread;
+
+    void loop();
+    void compact();
+    uint64_t schedule(clock::time_point deadline, std::function<void()> f);
+    void cancel(uint64_t id);
+  };
+
+  void deadline_service::_service_t::loop() {
+    std::unique_lock lock{mutex};
+    while(!stop) {
+      while(!heap.empty() && callbacks.count(heap.front().id) == 0) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.pop_back();
+      }
+
+      if(heap.empty()) {
+        wakeup.wait(lock);
+        continue;
+      }
+
+      entry_t top = heap.front();
+      if(clock::now() < top.deadline) {
+        wakeup.wait_until(lock, top.deadline);
+        continue;
+      }
+
+      std::pop_heap(heap.begin(), heap.end());
+      heap.pop_back();
+
+      auto it = callbacks.find(top.id);
+      std::function<void()> callback = std::move(it->second);
+      callbacks.erase(it);
+
+      running = top.id;
+      lock.unlock();
+      callback();
+      lock.lock();
+      running = 0;
+      done.notify_all();
+    }
+  }
+
+  void deadline_service::_service_t::compact() {
+    std::erase_if(heap, [&](entry_t e) {
+      return callbacks.count(e.id) == 0;
+    });
+    std::make_heap(heap.begin(), heap.end());
+  }
+
+  uint64_t deadline_service::_service_t::schedule(
+    clock::time_point deadline, std::function<void()> f
+  ) {
+    std::lock_guard lock{mutex};
+    if(!thread.joinable())
+      thread = std::thread([this]{ loop(); });
+
+    uint64_t id = next_id++;
+    callbacks.insert({id, std::move(f)});
+    heap.push_back({deadline, id});
+    std::push_heap(heap.begin(), heap.end());
+
+    // the timer thread only needs to know about new earliest deadlines
+    if(heap.front().id == id)
+      wakeup.notify_one();
+
+    return id;
+  }
+
+  void deadline_service::_service_t::cancel(uint64_t id) {
+    std::unique_lock lock{mutex};
+    callbacks.erase(id);
+
+    // short deadlines are usually cancelled much before they expire, so
+    // without compaction the heap would grow with the number of calls
+    if(heap.size() > 2 * callbacks.size() + 64)
+      compact();
+
+    // a callback cancelling itself must not wait for itself to finish
+    if(std::this_thread::get_id() != thread.get_id())
+      done.wait(lock, [&]{ return running != id; });
+  }
+
+  deadline_service::deadline_service()
+    : _data{std::make_unique<_service_t>()} { }
+
+  deadline_service::~deadline_service() {
+    {
+      std::lock_guard lock{_data->mutex};
+      _data->stop = true;
+    }
+    _data->wakeup.notify_one();
+    if(_data->thread.joinable())
+      _data->thread.join();
+  }
+
+  deadline_service &deadline_service::instance() {
+    static deadline_service service;
+    return service;
+  }
+
+  deadline_service::ticket deadline_service::schedule(
+    clock::time_point deadline, std::function<void()> callback
+  ) {
+    return ticket{_data->schedule(deadline, std::move(callback))};
+  }
+
+  void deadline_service::ticket::cancel() {
+    if(_id == 0)
+      return;
+
+    instance()._data->cancel(_id);
+    _id = 0;
+  }
+
+}
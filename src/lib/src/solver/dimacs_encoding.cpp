@@ -0,0 +1,392 @@
+//
+// BLACK - Bounded Ltl sAtisfiability ChecKer
+//
+// (C) 2019 Luca Geatti
+// (C) 2019 Nicola Gigante
+// (C) 2020 Gabriele Venturato
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <black/solver/dimacs_encoding.hpp>
+#include <black/support/range.hpp>
+
+namespace black_internal::encoder
+{
+  using black::sat::dimacs::literal;
+
+  static literal neg(literal l) {
+    return {!l.sign, l.var};
+  }
+
+  std::optional<dimacs_encoder> dimacs_encoder::make(
+    encoder &enc, black::sat::dimacs::solver &sat
+  ) {
+    if(!enc.get_formula().to<formula<LTLP>>())
+      return {};
+
+    alphabet &sigma = *enc._sigma;
+
+    // the template is the k-unraveling for k = 1, together with the 
+    // definitions of the eventualities and of the past targets at step 1
+    formula<FO> defs = big_and(sigma, enc._requests, [&](req_t req) {
+      formula<FO> def = sigma.top();
+      if(auto ev = encoder::_get_ev(req.target); ev)
+        def = iff(stepped(*ev, 1), enc.to_ground_snf(*ev, 1, {}));
+      if(req.type == req_t::past)
+        def = def && iff(
+          stepped(req.target, 1), enc.to_ground_snf(req.target, 1, {})
+        );
+      return def;
+    });
+
+    bool set = sat.set_step_template(
+      enc.k_unraveling(1) && defs, &encoder::step_of, &encoder::at_step
+    );
+    if(!set)
+      return {};
+
+    dimacs_encoder result{enc, sat};
+    auto slot = [&](formula<FO> f) -> std::optional<uint32_t> {
+      auto p = f.to<proposition>();
+      black_assert(p.has_value());
+      return sat.template_slot(*p);
+    };
+
+    for(req_t req : enc._requests) {
+      std::optional<uint32_t> g = slot(enc.ground(req, 0));
+      if(!g)
+        return {};
+      result._grounds.push_back(*g);
+
+      std::optional<uint32_t> ev;
+      if(auto f = encoder::_get_ev(req.target); f) {
+        ev = slot(stepped(*f, 0));
+        if(!ev)
+          return {};
+      }
+      result._evs.push_back(ev);
+
+      std::optional<uint32_t> target;
+      if(req.type == req_t::past) {
+        target = slot(stepped(req.target, 0));
+        if(!target)
+          return {};
+      }
+      result._targets.push_back(target);
+    }
+
+    std::optional<uint32_t> not_last = slot(enc.not_last_prop(0));
+    if(!not_last)
+      return {};
+    result._not_last = *not_last;
+
+    result._eqs.resize(1);
+    result._seens.resize(
+      enc._requests.size(), std::vector<std::vector<uint32_t>>(1)
+    );
+
+    return result;
+  }
+
+  proposition dimacs_encoder::stepped(formula<LTLPFO> f, size_t k) {
+    // the same name as `encoder::stepped()` for propositions
+    return f.sigma()->proposition(std::pair{f, k});
+  }
+
+  literal dimacs_encoder::ground(size_t req, size_t k) {
+    return {true, _sat->template_var(_grounds[req], k)};
+  }
+
+  literal dimacs_encoder::ev(size_t req, size_t k) {
+    black_assert(_evs[req].has_value());
+    return {true, _sat->template_var(*_evs[req], k)};
+  }
+
+  literal dimacs_encoder::target(size_t req, size_t k) {
+    black_assert(_targets[req].has_value());
+    return {true, _sat->template_var(*_targets[req], k)};
+  }
+
+  literal dimacs_encoder::eq(size_t l, size_t k) {
+    black_assert(l < k && k < _eqs.size());
+    return {true, _eqs[k][l]};
+  }
+
+  literal dimacs_encoder::seen(size_t req, size_t i, size_t k) {
+    black_assert(0 < i && i <= k && k < _seens[req].size());
+    return {true, _seens[req][k][i - 1]};
+  }
+
+  literal dimacs_encoder::fresh() {
+    return {true, _sat->fresh_var()};
+  }
+
+  void dimacs_encoder::assert_k_unraveling(size_t k) {
+    black_assert(k > 0);
+    _sat->assert_step(k);
+  }
+
+  tribool dimacs_encoder::is_sat_with_empty_or_loop(size_t k) {
+    black_assert(k > 0);
+    std::vector<req_t> const& requests = _enc->_requests;
+
+    // EMPTY_k is a conjunction of literals
+    std::vector<literal> empty;
+    for(size_t r = 0; r < requests.size(); ++r) {
+      if(requests[r].type != req_t::future)
+        continue;
+      if(!_enc->_finite || requests[r].strength == req_t::strong)
+        empty.push_back(neg(ground(r, k)));
+      else
+        empty.push_back(ground(r, k));
+    }
+    empty.push_back({false, _sat->template_var(_not_last, k)});
+
+    _loops.clear();
+    _loop_found.reset();
+    if(_enc->_finite)
+      return _sat->is_sat_with(empty);
+
+    // Otherwise, `choice` is assumed and chooses either EMPTY_k or one of
+    // the _lL_k && _lP_k, each implied by a fresh literal. The implications 
+    // suffice since the literals only occur positively, and any loop they 
+    // give is a correct one for `loop()`. With the compact encoding, there
+    // is a single literal for LOOP_k instead (see `compact_loop()`).
+    literal choice = fresh();
+    literal e = fresh();
+    for(literal lit : empty)
+      _sat->assert_clause({neg(e), lit});
+
+    std::vector<literal> choices = {neg(choice), e};
+    if(_enc->get_loop_encoding() == loop_encoding::compact) {
+      literal lp = compact_loop(k);
+      _loop_found = lp.var;
+      choices.push_back(lp);
+    } else {
+      for(size_t l = 0; l < k; ++l) {
+        literal lp = fresh();
+        _loops.push_back(lp.var);
+        choices.push_back(lp);
+
+        for(size_t r = 0; r < requests.size(); ++r) {
+          // _lL_k
+          _sat->assert_clause({neg(lp), neg(ground(r, l)), ground(r, k)});
+          _sat->assert_clause({neg(lp), ground(r, l), neg(ground(r, k))});
+          if(requests[r].type == req_t::past) {
+            _sat->assert_clause({neg(lp), neg(ground(r, l + 1)), target(r, k)});
+            _sat->assert_clause({neg(lp), ground(r, l + 1), neg(target(r, k))});
+          }
+
+          // _lP_k
+          if(_evs[r]) {
+            std::vector<literal> period = {neg(lp), neg(ground(r, k))};
+            for(size_t i = l + 1; i <= k; ++i)
+              period.push_back(ev(r, i));
+            _sat->assert_clause(period);
+          }
+        }
+      }
+    }
+    _sat->assert_clause(choices);
+
+    tribool result = _sat->is_sat_with(std::vector<literal>{choice});
+
+    // the model must be read before adding other clauses
+    if(result != true)
+      _sat->assert_clause({neg(choice)});
+
+    return result;
+  }
+
+  literal dimacs_encoder::compact_loop(size_t k) {
+    std::vector<req_t> const& requests = _enc->_requests;
+    black_assert(_starts.size() + 1 == k);
+
+    // the clauses of x <-> (c ? a : b)
+    auto ite = [&](literal x, literal c, literal a, literal b) {
+      _sat->assert_clause({neg(x), neg(c), a});
+      _sat->assert_clause({neg(x), c, b});
+      _sat->assert_clause({x, neg(c), neg(a)});
+      _sat->assert_clause({x, c, neg(b)});
+    };
+
+    // the clauses of x <-> (a && b)
+    auto conj = [&](literal x, literal a, literal b) {
+      _sat->assert_clause({neg(x), a});
+      _sat->assert_clause({neg(x), b});
+      _sat->assert_clause({x, neg(a), neg(b)});
+    };
+
+    // the selector of step k - 1 is also the `started` variable of k = 1
+    literal start = fresh();
+    literal started = start;
+    if(k > 1) {
+      literal before = {true, _started};
+      started = fresh();
+      _sat->assert_clause({neg(started), before, start});
+      _sat->assert_clause({started, neg(before)});
+      _sat->assert_clause({started, neg(start)});
+      _sat->assert_clause({neg(start), neg(before)});
+    }
+    _starts.push_back(start.var);
+    _started = started.var;
+
+    if(k == 1) {
+      _loop_states.resize(requests.size());
+      _loop_next_states.resize(requests.size());
+      _loop_seens.resize(requests.size());
+    }
+
+    literal lp = fresh();
+    _sat->assert_clause({neg(lp), started});
+
+    for(size_t r = 0; r < requests.size(); ++r) {
+      literal state = fresh();
+      if(k == 1)
+        conj(state, start, ground(r, k - 1));
+      else
+        ite(state, start, ground(r, k - 1), {true, _loop_states[r]});
+      _loop_states[r] = state.var;
+
+      _sat->assert_clause({neg(lp), neg(state), ground(r, k)});
+      _sat->assert_clause({neg(lp), state, neg(ground(r, k))});
+
+      if(requests[r].type == req_t::past) {
+        literal next = fresh();
+        if(k == 1)
+          conj(next, start, ground(r, k));
+        else
+          ite(next, start, ground(r, k), {true, _loop_next_states[r]});
+        _loop_next_states[r] = next.var;
+
+        _sat->assert_clause({neg(lp), neg(next), target(r, k)});
+        _sat->assert_clause({neg(lp), next, neg(target(r, k))});
+      }
+
+      if(_evs[r]) {
+        // `s` only occurs positively, so its implication suffices
+        literal s = fresh();
+        if(k == 1) {
+          _sat->assert_clause({neg(s), started});
+          _sat->assert_clause({neg(s), ev(r, k)});
+        } else {
+          literal before = {true, _loop_seens[r]};
+          _sat->assert_clause({neg(s), before, started});
+          _sat->assert_clause({neg(s), before, ev(r, k)});
+        }
+        _loop_seens[r] = s.var;
+
+        _sat->assert_clause({neg(lp), neg(ground(r, k)), s});
+      }
+    }
+
+    return lp;
+  }
+
+  void dimacs_encoder::assert_not_prune(size_t k) {
+    black_assert(k > 0 && _eqs.size() == k);
+    std::vector<req_t> const& requests = _enc->_requests;
+
+    // the definitions of the equalities between step k and the previous ones
+    std::vector<uint32_t> eqs;
+    for(size_t l = 0; l < k; ++l) {
+      literal e = fresh();
+      eqs.push_back(e.var);
+
+      // `differs` tells that step l and k differ on some request, each
+      // `d` being implied by a difference on one of them
+      std::vector<literal> differs = {e};
+      for(size_t r = 0; r < requests.size(); ++r) {
+        literal gl = ground(r, l);
+        literal gk = ground(r, k);
+        _sat->assert_clause({neg(e), neg(gl), gk});
+        _sat->assert_clause({neg(e), gl, neg(gk)});
+
+        literal d = fresh();
+        _sat->assert_clause({neg(d), gl, gk});
+        _sat->assert_clause({neg(d), neg(gl), neg(gk)});
+        differs.push_back(d);
+      }
+      _sat->assert_clause(differs);
+    }
+    _eqs.push_back(std::move(eqs));
+
+    if(_enc->_finite) {
+      for(size_t l = 0; l < k; ++l)
+        _sat->assert_clause({neg(eq(l, k))});
+      return;
+    }
+
+    // the definitions of the seen literals new at bound k. The one for the
+    // range from k to k is the eventuality at step k itself
+    for(size_t r = 0; r < requests.size(); ++r) {
+      if(!_evs[r])
+        continue;
+      
+      literal ev_k = ev(r, k);
+      std::vector<uint32_t> seens;
+      for(size_t i = 1; i < k; ++i) {
+        literal s = fresh();
+        literal before = seen(r, i, k - 1);
+        _sat->assert_clause({neg(s), before, ev_k});
+        _sat->assert_clause({s, neg(before)});
+        _sat->assert_clause({s, neg(ev_k)});
+        seens.push_back(s.var);
+      }
+      seens.push_back(ev_k.var);
+      _seens[r].push_back(std::move(seens));
+    }
+
+    // the negation of the PRUNE itself
+    for(size_t l = 0; l < k; ++l) {
+      for(size_t j = l + 1; j < k; ++j) {
+        std::vector<literal> c = {neg(eq(l, j)), neg(eq(j, k))};
+        for(size_t r = 0; r < requests.size(); ++r) {
+          if(!_evs[r])
+            continue;
+          
+          // `t` implies that the _lPRUNE_j^k fails on this request
+          literal t = fresh();
+          _sat->assert_clause({neg(t), ground(r, k)});
+          _sat->assert_clause({neg(t), seen(r, j + 1, k)});
+          _sat->assert_clause({neg(t), neg(seen(r, l + 1, j))});
+          c.push_back(t);
+        }
+        _sat->assert_clause(c);
+      }
+    }
+  }
+
+  std::optional<size_t> dimacs_encoder::loop() const {
+    if(_loop_found) {
+      if(_sat->value(*_loop_found) != true)
+        return {};
+      for(size_t l = 0; l < _starts.size(); ++l)
+        if(_sat->value(_starts[l]) == true)
+          return l;
+      return {};
+    }
+
+    for(size_t l = 0; l < _loops.size(); ++l)
+      if(_sat->value(_loops[l]) == true)
+        return l;
+    return {};
+  }
+
+}
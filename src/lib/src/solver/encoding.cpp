@@ -27,6 +27,7 @@
 #include <black/support/range.hpp>
 #include <black/logic/prettyprint.hpp>
 
+#include <algorithm>
 #include <string_view>
 
 using namespace std::literals;
@@ -34,21 +35,67 @@ using namespace std::literals;
 namespace black_internal::encoder
 {
   // Generates the PRUNE encoding
+  //
+  // The encoding is incremental: the pairwise state equalities and the
+  // ranges where eventualities are fulfilled are named by auxiliary literals,
+  // whose definitions for the new bound are returned together with the
+  // PRUNE itself (the latter by loop_axioms() instead, with the pairwise 
+  // LOOP encoding). Hence the negation of prune(k) must be asserted for all 
+  // the bounds up to k.
   formula<FO> encoder::prune(size_t k)
   {
+    formula<FO> axioms = prune_axioms(k);
+
     if(_finite)
-      return big_or(*_sigma, range(0, k), [&](size_t l) {
-        return l_to_k_loop(l, k, false);
-      });
+      return implies(axioms, big_or(*_sigma, range(0, k), [&](size_t l) {
+        return eq_prop(l, k);
+      }));
 
-    return big_or(*_sigma, range(0, k), [&](size_t l) {
+    return implies(axioms, big_or(*_sigma, range(0, k), [&](size_t l) {
       return big_or(*_sigma, range(l + 1, k), [&](size_t j) {
-        return l_to_k_loop(l,j,false) && l_to_k_loop(j,k, false) && 
-               l_j_k_prune(l,j,k);
+        return eq_prop(l, j) && eq_prop(j, k) && l_j_k_prune(l,j,k);
       });
+    }));
+  }
+
+  // Generates the definitions of the auxiliary literals used by prune(k) 
+  // that are new at bound k
+  formula<FO> encoder::prune_axioms(size_t k)
+  {
+    formula<FO> eqs = big_and(*_sigma, range(0, k), [&](size_t l) {
+      return iff(eq_prop(l, k), l_to_k_loop(l, k, false));
     });
+
+    // with the pairwise LOOP encoding, the `seen` literals are already 
+    // defined by loop_axioms()
+    if(_finite || _loops == loop_encoding::pairwise)
+      return eqs;
+
+    return eqs && seen_axioms(k);
   }
 
+  // Generates the definitions of the `seen` literals new at bound k, telling
+  // whether the eventuality of each request is fulfilled between steps i and
+  // k, for 0 < i <= k. Each one is defined from the one of the previous 
+  // bound, so only the SNF of the eventualities at step k is needed.
+  formula<FO> encoder::seen_axioms(size_t k) {
+    return big_and(*_sigma, _requests, [&](req_t req) -> formula<FO> {
+      std::optional<formula<LTLPFO>> ev = _get_ev(req.target);
+      if(!ev || k == 0)
+        return _sigma->top();
+      
+      formula<FO> ev_k = to_ground_snf(*ev, k, req.signature);
+
+      return big_and(*_sigma, range(1, k + 1), [&](size_t i) {
+        if(i == k)
+          return forall(req.signature, iff(seen(req, k, k), ev_k));
+        
+        return forall(req.signature, 
+          iff(seen(req, i, k), seen(req, i, k - 1) || ev_k)
+        );
+      });
+    });
+  }
 
   // Generates the _lPRUNE_j^k encoding
   formula<FO> encoder::l_j_k_prune(size_t l, size_t j, size_t k) {
@@ -59,18 +106,12 @@ namespace black_internal::encoder
         return _sigma->top();
 
       // Creating the encoding
-      formula inner_impl = 
-        big_or(*_sigma, range(j + 1, k + 1), [&](size_t i) {
-          return to_ground_snf(*ev, i, req.signature);
-        });
+      formula first_conj = ground(req, k) && seen(req, j + 1, k);
+      formula second_conj = seen(req, l + 1, j);
 
-      formula first_conj = ground(req, k) && inner_impl;
-      formula second_conj = 
-        big_or(*_sigma, range(l + 1, j + 1), [&](size_t i) {
-          return to_ground_snf(*ev, i, req.signature);
-        });
-
-      return forall(req.signature, implies(first_conj, second_conj));
+      return guarded(
+        req, forall(req.signature, implies(first_conj, second_conj))
+      );
     });
   }
 
@@ -101,13 +142,52 @@ namespace black_internal::encoder
     return sigma->proposition(std::tuple{"_loop_prop"sv, l, k});
   }
 
+  proposition encoder::loop_start_prop(alphabet *sigma, size_t l) {
+    return sigma->proposition(std::tuple{"_loop_start"sv, l});
+  }
+
+  proposition encoder::loop_found_prop(alphabet *sigma, size_t k) {
+    return sigma->proposition(std::tuple{"_loop_found"sv, k});
+  }
+
+  proposition encoder::empty_or_loop_prop(alphabet *sigma, size_t k) {
+    return sigma->proposition(std::tuple{"_empty_or_loop"sv, k});
+  }
+
   // Generates the encoding for LOOP_k
   // This is modified to allow the extraction of the loop index when printing
   // the model of the formula
+  //
+  // With the compact encoding, the conditions of _lL_k and _lP_k are stated
+  // only once, over the literals defined by loop_axioms() for the start of 
+  // the loop chosen by the `loop_start_prop()` selectors.
   formula<FO> encoder::k_loop(size_t k) {
-    if(_finite)
+    if(_finite || k == 0)
       return _sigma->bottom();
 
+    if(_loops == loop_encoding::compact) {
+      proposition found = loop_found_prop(_sigma, k);
+      formula<FO> conds = big_and(*_sigma, _requests, [&](req_t req) {
+        formula<FO> f = 
+          iff(loop_literal("_loop_state"sv, req, k - 1), ground(req, k));
+        
+        if(req.type == req_t::past)
+          f = f && iff(
+            loop_literal("_loop_next_state"sv, req, k), 
+            to_ground_snf(req.target, k, req.signature)
+          );
+        
+        if(_get_ev(req.target))
+          f = f && implies(
+            ground(req, k), loop_literal("_loop_seen"sv, req, k)
+          );
+
+        return guarded(req, forall(req.signature, f));
+      });
+
+      return iff(found, loop_started_prop(k - 1) && conds) && found;
+    }
+
     formula axioms = big_and(*_sigma, range(0,k), [&](size_t l) {
       proposition lp = loop_prop(_sigma, l, k);
       return iff(lp, l_to_k_loop(l, k, true) && l_to_k_period(l, k));
@@ -120,7 +200,72 @@ namespace black_internal::encoder
     });
   }
 
+  // Generates the definitions of the literals of the compact LOOP encoding
+  // that are new at bound k. The selector of step k - 1 is the only one 
+  // true among those up to k - 1 if the loop starts there, and the other 
+  // literals are defined inductively, as if-then-else on the selector, so 
+  // each bound only adds O(|requests|) formulas instead of the O(k^2) 
+  // conditions of the pairwise encoding.
+  //
+  // With the pairwise encoding, these are the definitions of the `seen` 
+  // literals used by _lP_k (see seen_axioms()). They are kept out of the
+  // k-unraveling, which must only talk about steps k - 1 and k to be used
+  // as a step template (see `dimacs_encoder`).
+  formula<FO> encoder::loop_axioms(size_t k) {
+    if(_finite || k == 0)
+      return _sigma->top();
+
+    if(_loops == loop_encoding::pairwise)
+      return seen_axioms(k);
+
+    proposition start = loop_start_prop(_sigma, k - 1);
+    proposition started = loop_started_prop(k - 1);
+
+    formula<FO> starts = iff(started, start);
+    if(k > 1) {
+      proposition before = loop_started_prop(k - 2);
+      starts = iff(started, before || start) && implies(start, !before);
+    }
+
+    return starts && big_and(*_sigma, _requests, [&](req_t req) {
+      nest_scope_t next{_xi};
+
+      for(auto d : req.signature)
+        _xi.declare(d, scope::rigid);
+
+      formula<FO> state = start && ground(req, k - 1);
+      if(k > 1)
+        state = state || (!start && loop_literal("_loop_state"sv, req, k - 2));
+      
+      formula<FO> f = iff(loop_literal("_loop_state"sv, req, k - 1), state);
+
+      if(req.type == req_t::past) {
+        formula<FO> next_state = start && ground(req, k);
+        if(k > 1)
+          next_state = next_state || 
+            (!start && loop_literal("_loop_next_state"sv, req, k - 1));
+        
+        f = f && iff(loop_literal("_loop_next_state"sv, req, k), next_state);
+      }
+
+      if(auto ev = _get_ev(req.target); ev) {
+        formula<FO> seen_k = 
+          started && to_ground_snf(*ev, k, req.signature);
+        if(k > 1)
+          seen_k = loop_literal("_loop_seen"sv, req, k - 1) || seen_k;
+
+        f = f && iff(loop_literal("_loop_seen"sv, req, k), seen_k);
+      }
+
+      return forall(req.signature, f);
+    });
+  }
+
   // Generates the encoding for _lP_k
+  //
+  // The eventualities fulfilled between steps l + 1 and k are told by the 
+  // `seen` literals defined by loop_axioms() (see seen_axioms()), so the
+  // older steps are not needed anymore.
   formula<FO> encoder::l_to_k_period(size_t l, size_t k) {
 
     return big_and(*_sigma, _requests, [&](req_t req) -> formula<FO> {
@@ -130,12 +275,11 @@ namespace black_internal::encoder
       
       // Creating the encoding
       formula<FO> proposition_phi_k = ground(req, k);
-      formula<FO> body_impl = 
-        big_or(*_sigma, range(l + 1, k + 1), [&](size_t i) {
-          return to_ground_snf(*ev, i, req.signature);
-        });
+      formula<FO> body_impl = seen(req, l + 1, k);
 
-      return forall(req.signature, implies(proposition_phi_k, body_impl));
+      return guarded(
+        req, forall(req.signature, implies(proposition_phi_k, body_impl))
+      );
     });
   }
 
@@ -151,7 +295,7 @@ namespace black_internal::encoder
           iff( ground(req, l+1), to_ground_snf(req.target, k, req.signature) )
         );
 
-      return f;
+      return guarded(req, f);
     });
   }
 
@@ -174,6 +318,10 @@ namespace black_internal::encoder
       return to_ground_snf(_frm, k, {}) && !not_first_prop(0) && init;
     }
 
+    // the steps before k - 1 are not used anymore
+    for(size_t i = 0; i + 1 < k && i < _snf_cache.size(); ++i)
+      _snf_cache[i] = {};
+
     auto reqs = big_and(*_sigma, _requests, [&](req_t req) {
       nest_scope_t next{_xi};
 
@@ -208,7 +356,34 @@ namespace black_internal::encoder
   
   // Turns the current formula into Stepped Normal Form
   // Note: this has to be run *after* the transformation to NNF (to_nnf() below)
+  //
+  // The SNF of the same subformulas at the same steps is needed many times,
+  // e.g. by l_to_k_period() for all the loops ending at each k, so it is 
+  // memoized. Only the last two steps are ever used again (see 
+  // k_unraveling()), so the older ones are evicted from the cache.
+  //
   formula<FO> encoder::to_ground_snf(
+    formula<LTLPFO> f, size_t k, std::vector<var_decl> const& env
+  ) {
+    if(_snf_cache.size() <= k)
+      _snf_cache.resize(k + 1);
+
+    // the environment is copied only the first time it is seen
+    auto it = _envs.find(env);
+    if(it == _envs.end())
+      it = _envs.insert({env, _envs.size()}).first;
+    snf_key_t key{f, it->second};
+
+    if(auto hit = _snf_cache[k].find(key); hit != _snf_cache[k].end())
+      return hit->second;
+
+    formula<FO> snf = _to_ground_snf(f, k, env);
+    _snf_cache[k].insert({key, snf});
+
+    return snf;
+  }
+
+  formula<FO> encoder::_to_ground_snf(
     formula<LTLPFO> f, size_t k, std::vector<var_decl> env
   ) {
     return f.match( // LCOV_EXCL_LINE
@@ -480,6 +655,23 @@ namespace black_internal::encoder
     return p.sigma()->proposition(std::pair{formula<LTLPFO>{p}, k});
   }
 
+  std::optional<size_t> encoder::step_of(proposition p) {
+    if(auto name = p.name().get<std::pair<formula<LTLPFO>, size_t>>(); name)
+      return name->second;
+    if(auto name = p.name().get<std::pair<req_t, size_t>>(); name)
+      return name->second;
+    return {};
+  }
+
+  proposition encoder::at_step(proposition p, size_t k) {
+    if(auto name = p.name().get<std::pair<formula<LTLPFO>, size_t>>(); name)
+      return p.sigma()->proposition(std::pair{name->first, k});
+    
+    auto name = p.name().get<std::pair<req_t, size_t>>();
+    black_assert(name);
+    return p.sigma()->proposition(std::pair{name->first, k});
+  }
+
   proposition encoder::not_last_prop(size_t k) {
     return stepped(_sigma->proposition("__not_last"sv), k);
   }
@@ -536,6 +728,45 @@ namespace black_internal::encoder
     return rel(req.signature);
   }
 
+  proposition encoder::eq_prop(size_t l, size_t k) {
+    return _sigma->proposition(std::tuple{"_eq_prop"sv, l, k});
+  }
+
+  formula<FO> encoder::seen(req_t req, size_t i, size_t j) {
+    if(req.signature.empty())
+      return _sigma->proposition(std::tuple{"_seen_prop"sv, req, i, j});
+    
+    auto rel = _sigma->relation(std::tuple{"_seen_prop"sv, req, i, j});
+    if(!_xi.signature(rel))
+      _global_xi->declare(rel, req.signature, scope::rigid);
+    
+    return rel(req.signature);
+  }
+
+  proposition encoder::loop_started_prop(size_t l) {
+    return _sigma->proposition(std::tuple{"_loop_started"sv, l});
+  }
+
+  formula<FO> encoder::loop_literal(std::string_view kind, req_t req, size_t k)
+  {
+    if(req.signature.empty())
+      return _sigma->proposition(std::tuple{kind, req, k});
+    
+    auto rel = _sigma->relation(std::tuple{kind, req, k});
+    if(!_xi.signature(rel))
+      _global_xi->declare(rel, req.signature, scope::rigid);
+    
+    return rel(req.signature);
+  }
+
+  formula<FO> encoder::guarded(req_t req, formula<FO> f) {
+    if(_guards.empty())
+      return f;
+
+    black_assert(_relevance.contains(req));
+    return implies(_relevance.at(req), f);
+  }
+
   formula<FO> encoder::forall(std::vector<var_decl> env, formula<FO> f) {
     if(env.empty())
       return f;
@@ -543,12 +774,121 @@ namespace black_internal::encoder
     return logic::forall(env, f);
   }
 
-  // Transformation in NNF
+  // The formulas whose NNF is used by `_to_nnf(f)`
+  static void nnf_operands(
+    formula<LTLPFO> f, std::vector<formula<LTLPFO>> &ops
+  ) {
+    f.match(
+      [](boolean) { },
+      [](proposition) { },
+      [](atom<LTLPFO>) { },
+      [](equality<LTLPFO>) { },
+      [](comparison<LTLPFO>) { },
+      [&](quantifier<LTLPFO> q) {
+        ops.push_back(q.matrix());
+      },
+      [&](negation<LTLPFO> n) {
+        n.argument().match(
+          [](boolean) { },
+          [](proposition) { },
+          [](atom<LTLPFO>) { },
+          [](equality<LTLPFO>) { },
+          [](comparison<LTLPFO>) { },
+          [&](quantifier<LTLPFO> q) {
+            ops.push_back(!q.matrix());
+          },
+          [&](negation<LTLPFO>, auto op) {
+            ops.push_back(op);
+          },
+          [&](unary<LTLPFO> u) {
+            ops.push_back(!u.argument());
+          },
+          [&](implication<LTLPFO>, auto left, auto right) {
+            ops.push_back(left);
+            ops.push_back(!right);
+          },
+          [&](iff<LTLPFO>, auto left, auto right) {
+            ops.push_back(!implies(left, right));
+            ops.push_back(!implies(right, left));
+          },
+          [&](conjunction<LTLPFO> c) {
+            for(auto op : c.operands())
+              ops.push_back(!op);
+          },
+          [&](disjunction<LTLPFO> c) {
+            for(auto op : c.operands())
+              ops.push_back(!op);
+          },
+          [&](binary<LTLPFO>, auto left, auto right) {
+            ops.push_back(!left);
+            ops.push_back(!right);
+          }
+        );
+      },
+      [&](unary<LTLPFO> u) {
+        ops.push_back(u.argument());
+      },
+      [&](implication<LTLPFO>, auto left, auto right) {
+        ops.push_back(!left);
+        ops.push_back(right);
+      },
+      [&](iff<LTLPFO>, auto left, auto right) {
+        ops.push_back(implies(left, right));
+        ops.push_back(implies(right, left));
+      },
+      [&](conjunction<LTLPFO> c) {
+        for(auto op : c.operands())
+          ops.push_back(op);
+      },
+      [&](disjunction<LTLPFO> c) {
+        for(auto op : c.operands())
+          ops.push_back(op);
+      },
+      [&](binary<LTLPFO>, auto left, auto right) {
+        ops.push_back(left);
+        ops.push_back(right);
+      }
+    );
+  }
+
+  // Transformation in NNF. Formulas can be very deep, so the operands are
+  // transformed first, in post-order with an explicit stack, and then 
+  // `_to_nnf()` finds them in the cache.
   formula<LTLPFO> encoder::to_nnf(formula<LTLPFO> f) {
     if(auto it = _nnf_cache.find(f); it != _nnf_cache.end())
-      return it->second;     
+      return it->second;
+
+    std::vector<formula<LTLPFO>> stack = {f};
+    std::vector<formula<LTLPFO>> ops;
+    while(!stack.empty()) {
+      formula<LTLPFO> g = stack.back();
+      if(_nnf_cache.contains(g)) {
+        stack.pop_back();
+        continue;
+      }
 
-    formula nnf = f.match( // LCOV_EXCL_LINE
+      ops.clear();
+      nnf_operands(g, ops);
+
+      bool ready = true;
+      for(formula<LTLPFO> op : ops) {
+        if(!_nnf_cache.contains(op)) {
+          stack.push_back(op);
+          ready = false;
+        }
+      }
+      if(!ready)
+        continue;
+      
+      stack.pop_back();
+      _nnf_cache.insert({g, _to_nnf(g)});
+    }
+
+    return _nnf_cache.at(f);
+  }
+
+  formula<LTLPFO> encoder::_to_nnf(formula<LTLPFO> f) {
+    return f.match( // LCOV_EXCL_LINE
       [](boolean b) { return b; },
       [](proposition p) { return p; },
       [](atom<LTLPFO> a) { return a; },
@@ -630,9 +970,6 @@ namespace black_internal::encoder
         );
       }
     );
-
-    _nnf_cache.insert({f, nnf});
-    return nnf;
   }
 
   encoder::formula_strength_t encoder::strength(formula<LTLPFO> f) {
@@ -684,62 +1021,115 @@ namespace black_internal::encoder
 
   void encoder::_collect_requests(formula<LTLPFO> f, std::vector<var_decl> env)
   { 
-    std::optional<req_t> req;
-    f.match(
-      [&](tomorrow<LTLPFO> t)      { req = mk_req(t, env);     },
-      [&](w_tomorrow<LTLPFO> t)    { req = mk_req(t, env);     },
-      [&](yesterday<LTLPFO> y)     { req = mk_req(y, env);     },
-      [&](w_yesterday<LTLPFO> y)   { req = mk_req(y, env);     },
-      [&](until<LTLPFO> u)         { req = mk_req(X(u), env);  },
-      [&](release<LTLPFO> r)       { req = mk_req(wX(r), env); },
-      [&](w_until<LTLPFO> r)       { req = mk_req(wX(r), env); },
-      [&](s_release<LTLPFO> r)     { req = mk_req(X(r), env);  },
-      [&](always<LTLPFO> a)        { req = mk_req(wX(a), env); },
-      [&](eventually<LTLPFO> e)    { req = mk_req(X(e), env);  },
-      [&](since<LTLPFO> s)         { req = mk_req(Y(s), env);  },
-      [&](once<LTLPFO> o)          { req = mk_req(Y(o), env);  },
-      [&](triggered<LTLPFO> t)     { req = mk_req(Z(t), env);  },
-      [&](historically<LTLPFO> h)  { req = mk_req(Z(h), env);  },
-      [&](atom<LTLPFO>, auto terms) {
-        for(auto t : terms) 
-          _collect_lookaheads(t);
-      },
-      [&](equality<LTLPFO>, auto terms) {
-        for(auto t : terms) 
-          _collect_lookaheads(t);
-      },
-      [&](comparison<LTLPFO>, auto left, auto right) {
-        _collect_lookaheads(left);
-        _collect_lookaheads(right);
-      },
-      [](otherwise) { }
-    );
+    // The subformulas to visit, in pre-order, each with the size of its 
+    // environment and the guards in whose scope it occurs (see `_guards`). 
+    // The traversal is depth-first, so the environment of each subformula is
+    // a prefix of `env` when it is visited.
+    struct frame_t {
+      formula<LTLPFO> f;
+      size_t size;
+      formula<FO> ctx;
+    };
+    std::vector<frame_t> stack = {{f, env.size(), _sigma->top()}};
+    while(!stack.empty()) {
+      auto [g, size, ctx] = stack.back();
+      stack.pop_back();
+      env.erase(env.begin() + ptrdiff_t(size), env.end());
+
+      std::optional<req_t> req;
+      g.match(
+        [&](tomorrow<LTLPFO> t)      { req = mk_req(t, env);     },
+        [&](w_tomorrow<LTLPFO> t)    { req = mk_req(t, env);     },
+        [&](yesterday<LTLPFO> y)     { req = mk_req(y, env);     },
+        [&](w_yesterday<LTLPFO> y)   { req = mk_req(y, env);     },
+        [&](until<LTLPFO> u)         { req = mk_req(X(u), env);  },
+        [&](release<LTLPFO> r)       { req = mk_req(wX(r), env); },
+        [&](w_until<LTLPFO> r)       { req = mk_req(wX(r), env); },
+        [&](s_release<LTLPFO> r)     { req = mk_req(X(r), env);  },
+        [&](always<LTLPFO> a)        { req = mk_req(wX(a), env); },
+        [&](eventually<LTLPFO> e)    { req = mk_req(X(e), env);  },
+        [&](since<LTLPFO> s)         { req = mk_req(Y(s), env);  },
+        [&](once<LTLPFO> o)          { req = mk_req(Y(o), env);  },
+        [&](triggered<LTLPFO> t)     { req = mk_req(Z(t), env);  },
+        [&](historically<LTLPFO> h)  { req = mk_req(Z(h), env);  },
+        [&](atom<LTLPFO>, auto terms) {
+          for(auto t : terms) 
+            _collect_lookaheads(t);
+        },
+        [&](equality<LTLPFO>, auto terms) {
+          for(auto t : terms) 
+            _collect_lookaheads(t);
+        },
+        [&](comparison<LTLPFO>, auto left, auto right) {
+          _collect_lookaheads(left);
+          _collect_lookaheads(right);
+        },
+        [](otherwise) { }
+      );
 
-    if(req)
-      _requests.push_back(*req);
+      if(req) {
+        if(_requests_set.insert(*req).second)
+          _requests.push_back(*req);
+        else
+          _duplicates++;
+      }
 
-    f.match(
-      [&](quantifier<LTLPFO>, auto vars, auto matrix) { 
-        env.insert(env.end(), vars.begin(), vars.end());
-        _collect_requests(matrix, env);
-      },
-      [&](unary<LTLPFO>, auto op) {
-        _collect_requests(op, env);
-      },
-      [&](conjunction<LTLPFO> c) {
-        for(auto op : c.operands())
-          _collect_requests(op, env);
-      },
-      [&](disjunction<LTLPFO> c) {
-        for(auto op : c.operands())
-          _collect_requests(op, env);
-      },
-      [&](binary<LTLPFO>, auto left, auto right) {
-        _collect_requests(left, env);
-        _collect_requests(right, env);
-      },
-      [](otherwise) { }
-    );
+      if(req && !_guards.empty()) {
+        auto it = _relevance.find(*req);
+        if(it == _relevance.end())
+          _relevance.insert({*req, ctx});
+        else if(it->second != ctx) {
+          formula<FO> relevance = it->second || ctx;
+          _relevance.erase(it);
+          _relevance.insert({*req, relevance});
+        }
+      }
+
+      // the guards among the operands of a conjunction, or the negated ones
+      // among those of a disjunction, disable the other operands
+      auto guard = [&](formula<LTLPFO> op, bool negated) {
+        if(negated) {
+          auto n = op.to<negation<LTLPFO>>();
+          if(!n)
+            return;
+          op = n->argument();
+        }
+        if(auto p = op.to<proposition>(); p && _guards.contains(*p))
+          ctx = ctx && stepped(*p, 0);
+      };
+
+      // the children are pushed in reverse, to be visited from left to right
+      size_t first = stack.size();
+      g.match(
+        [&](quantifier<LTLPFO>, auto vars, auto matrix) { 
+          env.insert(env.end(), vars.begin(), vars.end());
+          stack.push_back({matrix, env.size(), ctx});
+        },
+        [&](unary<LTLPFO>, auto op) {
+          stack.push_back({op, size, ctx});
+        },
+        [&](conjunction<LTLPFO> c) {
+          if(!_guards.empty())
+            for(auto op : c.operands())
+              guard(op, false);
+          for(auto op : c.operands())
+            stack.push_back({op, size, ctx});
+        },
+        [&](disjunction<LTLPFO> c) {
+          if(!_guards.empty())
+            for(auto op : c.operands())
+              guard(op, true);
+          for(auto op : c.operands())
+            stack.push_back({op, size, ctx});
+        },
+        [&](binary<LTLPFO>, auto left, auto right) {
+          stack.push_back({left, size, ctx});
+          stack.push_back({right, size, ctx});
+        },
+        [](otherwise) { }
+      );
+      std::reverse(stack.begin() + ptrdiff_t(first), stack.end());
+    }
   }
 
   void encoder::_collect_lookaheads(term<LTLPFO> t) {
@@ -761,8 +1151,12 @@ namespace black_internal::encoder
       [](otherwise) { }
     );
 
-    if(lh)
-      _lookaheads.push_back(*lh);
+    if(lh) {
+      if(_lookaheads_set.insert(*lh).second)
+        _lookaheads.push_back(*lh);
+      else
+        _duplicates++;
+    }
 
     for_each_child(t, [&](auto child) {
       child.match(
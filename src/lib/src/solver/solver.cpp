@@ -27,26 +27,80 @@
 #include <black/support/range.hpp>
 #include <black/solver/solver.hpp>
 #include <black/solver/encoding.hpp>
+#include <black/solver/dimacs_encoding.hpp>
+#include <black/solver/deadline.hpp>
 #include <black/sat/solver.hpp>
 
+#include <algorithm>
 #include <numeric>
 #include <atomic>
 #include <memory>
 #include <future>
+#include <mutex>
+#include <thread>
 
 namespace black_internal::solver
 {
+  /*
+   * A run of the main algorithm over a given SAT backend. In portfolio mode, 
+   * one run for each backend is executed on its own thread.
+   */
+  struct run_t 
+  {
+    run_t(
+      scope const& s, logic::formula<logic::LTLPFO> f, bool finite, 
+      loop_encoding loops, std::string _backend
+    ) : xi{chain(s)}, enc{f, xi, finite, loops}, backend{std::move(_backend)},
+        sat{black::sat::solver::get_solver(backend, xi)} { }
+
+    run_t(run_t const&) = delete;
+    run_t &operator=(run_t const&) = delete;
+
+    // scope where the encoder declares the stepped symbols
+    scope xi;
+
+    // encoder object used in the run
+    encoder::encoder enc;
+
+    // the name of the SAT backend
+    std::string backend;
+
+    // the SAT solver instance
+    std::unique_ptr<black::sat::solver> sat;
+
+    // the direct encoding, for propositional formulas over DIMACS backends
+    std::optional<encoder::dimacs_encoder> direct;
+
+    // the last bound tried by this run
+    size_t last_bound = 0;
+
+    // size of the found model (if any)
+    size_t model_size = 0;
+
+    // the flag for `interrupt()`
+    std::atomic<bool> interrupt_flag = false;
+
+    void interrupt() {
+      interrupt_flag = true;
+      sat->interrupt();
+    }
+  };
+
   /*
    * Private implementation of the solver class.
    */
-  struct solver::_solver_t : std::enable_shared_from_this<solver::_solver_t>
+  struct solver::_solver_t
   {
     // whether a model has been found 
     // i.e., whether solve() has been called and returned true
     bool model = false;
 
-    // encoder object used in the last solve() call
-    std::optional<encoder::encoder> enc;
+    // runs of the current solve() call. After the call, only the run that
+    // provided the answer is kept, to query the model
+    std::vector<std::unique_ptr<run_t>> runs;
+
+    // guards `runs` against concurrent calls to `interrupt()`
+    std::mutex runs_mutex;
 
     // alphabet of last solved formula
     alphabet *sigma = nullptr;
@@ -57,18 +111,40 @@ namespace black_internal::solver
     // value for solver::last_bound() 
     size_t last_bound = 0;
 
-    // current SAT solver instance
-    std::unique_ptr<black::sat::solver> sat;
+    // value for solver::last_duplicate_requests()
+    size_t duplicate_requests = 0;
+
+    // value for solver::last_direct_encoding()
+    bool direct_encoding = false;
 
     // the name of the currently chosen sat backend
     std::string sat_backend = BLACK_DEFAULT_BACKEND; // sensible default
 
-    // the flag for `interrupt()`
-    std::atomic<bool> interrupt_flag = false;
+    // the backends to run in parallel, if any
+    std::vector<std::string> portfolio;
+
+    // the encoding of LOOP_k
+    loop_encoding loops = loop_encoding::pairwise;
+
+    // the tuning options passed to the SAT backends, in the order given
+    std::vector<
+      std::pair<std::string, black::sat::option_value>
+    > backend_options;
+
+    // the backends to run, i.e. the portfolio, or the chosen backend if the
+    // portfolio is empty
+    std::vector<std::string> backends() const {
+      if(portfolio.empty())
+        return {sat_backend};
+      return portfolio;
+    }
 
     // tracer
     std::function<void(trace_t)> tracer = [](trace_t){};
 
+    // whether a tracer has been set
+    bool tracing = false;
+
     void trace(size_t k);
     void trace(trace_t::type_t, scope const&, logic::formula<logic::LTLPFO>);
     void trace(trace_t::type_t, scope const&, logic::formula<logic::FO>);
@@ -76,10 +152,24 @@ namespace black_internal::solver
     // Main algorithm
     tribool solve(
       scope const& xi, logic::formula<logic::LTLPFO> f, 
-      bool finite, size_t k_max, std::optional<std::chrono::seconds> timeout, 
+      bool finite, size_t k_max, std::optional<std::chrono::milliseconds> timeout, 
       bool semi_decision
     );
 
+    // Main loop of the algorithm for a single run. Accesses to the alphabet
+    // are serialized through `sigma_mutex`, if given, which is released 
+    // during the calls to the SAT solver. Concurrent alphabets need no
+    // serialization, so in that case `sigma_mutex` is null.
+    tribool solve(
+      run_t &run, size_t k_max, bool semi_decision, std::mutex *sigma_mutex
+    );
+
+    // the run that provided the last answer
+    run_t &last_run() {
+      black_assert(!runs.empty());
+      return *runs.front();
+    }
+
     void interrupt();
   };
 
@@ -91,7 +181,7 @@ namespace black_internal::solver
 
   tribool solver::solve(
     scope const& xi, logic::formula<logic::LTLPFO> f, 
-    bool finite, size_t k_max, std::optional<std::chrono::seconds> timeout,
+    bool finite, size_t k_max, std::optional<std::chrono::milliseconds> timeout,
     bool semi_decision
   ) {
     return _data->solve(xi, f, finite, k_max, timeout, semi_decision);
@@ -100,7 +190,7 @@ namespace black_internal::solver
   
   tribool solver::is_valid(
     scope const& xi, logic::formula<logic::LTLPFO> f, 
-    bool finite, size_t k_max, std::optional<std::chrono::seconds> timeout,
+    bool finite, size_t k_max, std::optional<std::chrono::milliseconds> timeout,
     bool semi_decision
   ) {
     tribool res = _data->solve(xi, !f, finite, k_max, timeout, semi_decision);
@@ -127,6 +217,14 @@ namespace black_internal::solver
     return _data->last_bound;
   }
 
+  size_t solver::last_duplicate_requests() const {
+    return _data->duplicate_requests;
+  }
+
+  bool solver::last_direct_encoding() const {
+    return _data->direct_encoding;
+  }
+
   void solver::set_sat_backend(std::string name) {
     _data->sat_backend = std::move(name);
   }
@@ -135,8 +233,52 @@ namespace black_internal::solver
     return _data->sat_backend;
   }
 
+  void solver::set_portfolio(std::vector<std::string> backends) {
+    for([[maybe_unused]] auto const& name : backends)
+      black_assert(black::sat::solver::backend_exists(name));
+
+    _data->portfolio = std::move(backends);
+  }
+
+  std::vector<std::string> solver::portfolio() const {
+    return _data->portfolio;
+  }
+
+  void solver::set_loop_encoding(loop_encoding encoding) {
+    _data->loops = encoding;
+  }
+
+  bool solver::set_backend_option(
+    std::string key, black::sat::option_value value
+  ) {
+    // the option is checked on scratch instances of the backends
+    alphabet sigma;
+    scope xi{sigma};
+
+    bool accepted = false;
+    for(auto const& name : _data->backends())
+      if(black::sat::solver::get_solver(name, xi)->set_option(key, value))
+        accepted = true;
+    
+    if(accepted)
+      _data->backend_options.push_back({std::move(key), std::move(value)});
+    
+    return accepted;
+  }
+
+  void solver::clear_backend_options() {
+    _data->backend_options.clear();
+  }
+
+  std::string solver::last_sat_backend() const {
+    if(_data->runs.empty())
+      return _data->sat_backend;
+    return _data->last_run().backend;
+  }
+
   void solver::set_tracer(std::function<void(trace_t)> const&tracer) {
     _data->tracer = tracer;
+    _data->tracing = true;
   }
 
   size_t model::size() const {
@@ -147,10 +289,29 @@ namespace black_internal::solver
     using black_internal::encoder::encoder;
     black_assert(size() > 0);
     
+    run_t &run = _solver._data->last_run();
     size_t k = size() - 1;
+    if(run.direct) {
+      if(auto l = run.direct->loop(); l)
+        return *l + 1;
+      return size();
+    }
+
+    alphabet *sigma = _solver._data->sigma;
+    if(run.enc.get_loop_encoding() == loop_encoding::compact) {
+      if(run.sat->value(encoder::loop_found_prop(sigma, k)) != true)
+        return size();
+
+      for(size_t l = 0; l < k; ++l)
+        if(run.sat->value(encoder::loop_start_prop(sigma, l)) == true)
+          return l + 1;
+
+      return size();
+    }
+
     for(size_t l = 0; l < k; ++l) {
-      proposition loop_prop = encoder::loop_prop(_solver._data->sigma, l, k);
-      tribool value = _solver._data->sat->value(loop_prop);
+      proposition loop_prop = encoder::loop_prop(sigma, l, k);
+      tribool value = run.sat->value(loop_prop);
       
       if(value == true)
         return l + 1;
@@ -163,34 +324,109 @@ namespace black_internal::solver
     using black_internal::encoder::encoder;
     proposition u = encoder::stepped(a, t);
 
-    return _solver._data->sat->value(u);
+    return _solver._data->last_run().sat->value(u);
+  }
+
+  model::trace model::values(std::vector<proposition> const& props) const {
+    using black_internal::encoder::encoder;
+
+    trace result;
+    result.props = props;
+    result.size = size();
+    result.loop = loop();
+    result.values.resize(result.size * props.size(), tribool::undef);
+
+    tsl::hopscotch_map<proposition, size_t> columns;
+    for(size_t i = 0; i < props.size(); ++i)
+      columns.insert({props[i], i});
+
+    // the step and the column of a stepped proposition, if any. Stepped
+    // propositions are named by pairs `(p, t)` (see `encoder::stepped()`), 
+    // so we can recognize them without building them
+    using cell_t = std::pair<size_t, size_t>;
+    auto column = [&](proposition u) -> std::optional<cell_t> {
+      auto name = u.name().to<std::pair<formula, size_t>>();
+      if(!name)
+        return {};
+      
+      auto p = name->first.to<proposition>();
+      if(!p)
+        return {};
+
+      if(auto it = columns.find(*p); it != columns.end())
+        return std::pair{name->second, it->second};
+      return {};
+    };
+
+    // the cells given by `for_each_value()`
+    std::vector<bool> known(result.values.size(), false);
+
+    black::sat::solver const &sat = *_solver._data->last_run().sat;
+    bool done = sat.for_each_value([&](proposition u, tribool v) {
+      if(auto c = column(u); c && c->first < result.size) {
+        result.values[c->first * props.size() + c->second] = v;
+        known[c->first * props.size() + c->second] = true;
+      }
+    });
+
+    if(!done)
+      for(size_t t = 0; t < result.size; ++t)
+        for(size_t i = 0; i < props.size(); ++i)
+          result.values[t * props.size() + i] = value(props[i], t);
+
+    // the values of the step template of DIMACS backends are given by slot,
+    // so the column of each slot is found only once. Propositions registered
+    // before the template was set keep their own variable, already given.
+    auto *dimacs = dynamic_cast<black::sat::dimacs::solver const *>(&sat);
+    if(!done || !dimacs)
+      return result;
+
+    std::vector<std::optional<size_t>> slots;
+    for(proposition slot : dimacs->template_slots()) {
+      auto c = column(slot);
+      slots.push_back(c ? std::optional{c->second} : std::nullopt);
+    }
+
+    dimacs->for_each_template_value([&](uint32_t slot, size_t k, tribool v) {
+      if(k >= result.size || !slots[slot])
+        return;
+      
+      size_t cell = k * props.size() + *slots[slot];
+      if(!known[cell])
+        result.values[cell] = v;
+    });
+
+    return result;
   }
 
   tribool model::value(atom a, size_t t) const {
-    if(!_solver._data->enc.has_value())
+    if(_solver._data->runs.empty())
       return tribool::undef;
 
-    logic::atom<logic::FO> u = _solver._data->enc->stepped(a, t);
+    run_t &run = _solver._data->last_run();
+    logic::atom<logic::FO> u = run.enc.stepped(a, t);
 
-    return _solver._data->sat->value(u);
+    return run.sat->value(u);
   }
 
   tribool model::value(equality e, size_t t) const {
-    if(!_solver._data->enc.has_value())
+    if(_solver._data->runs.empty())
       return tribool::undef;
 
-    logic::equality<logic::FO> u = _solver._data->enc->stepped(e, t);
+    run_t &run = _solver._data->last_run();
+    logic::equality<logic::FO> u = run.enc.stepped(e, t);
 
-    return _solver._data->sat->value(u);
+    return run.sat->value(u);
   }
 
   tribool model::value(comparison c, size_t t) const {
-    if(!_solver._data->enc.has_value())
+    if(_solver._data->runs.empty())
       return tribool::undef;
 
-    logic::comparison<logic::FO> u = _solver._data->enc->stepped(c, t);
+    run_t &run = _solver._data->last_run();
+    logic::comparison<logic::FO> u = run.enc.stepped(c, t);
 
-    return _solver._data->sat->value(u);
+    return run.sat->value(u);
   }
 
   void solver::_solver_t::trace(size_t k){
@@ -215,69 +451,207 @@ namespace black_internal::solver
    */
   tribool solver::_solver_t::solve(
     scope const& s, logic::formula<logic::LTLPFO> f, bool finite, 
-    size_t k_max, std::optional<std::chrono::seconds> timeout, 
+    size_t k_max, std::optional<std::chrono::milliseconds> timeout, 
     bool semi_decision
   ) {
-    scope xi = chain(s);
-    
-    enc = encoder::encoder{f, xi, finite};
-    sat = black::sat::solver::get_solver(sat_backend, xi);
-
-    trace(trace_t::nnf, xi, enc->get_formula());
+    // each backend of a portfolio only takes the options it knows, but each
+    // option must be taken by at least one backend
+    std::vector<bool> accepted(backend_options.size(), false);
+    {
+      std::lock_guard lock{runs_mutex};
+      runs.clear();
+      for(auto const& backend : backends()) {
+        auto run = std::make_unique<run_t>(s, f, finite, loops, backend);
+        
+        for(size_t i = 0; i < backend_options.size(); ++i) {
+          auto const& [key, value] = backend_options[i];
+          if(run->sat->set_option(key, value))
+            accepted[i] = true;
+        }
+        
+        runs.push_back(std::move(run));
+      }
+    }
 
     sigma = f.sigma();
     model = false;
     model_size = 0;
     last_bound = 0;
+    duplicate_requests = runs.front()->enc.duplicates();
+    direct_encoding = false;
 
+    if(std::find(accepted.begin(), accepted.end(), false) != accepted.end())
+      return tribool::undef;
+
+    trace(trace_t::nnf, runs.front()->xi, runs.front()->enc.get_formula());
+
+    // the deadline is cancelled when `deadline` goes out of scope
+    deadline_service::ticket deadline;
     if(timeout)
-      std::thread([timeout, self = this->shared_from_this()]() {
-        std::this_thread::sleep_for(*timeout);
-        self->interrupt();
-      }).detach();
+      deadline = deadline_service::instance().schedule(
+        deadline_service::clock::now() + *timeout,
+        [this]{ interrupt(); }
+      );
+
+    std::mutex mutex;
+    std::mutex *sigma_mutex = sigma->is_concurrent() ? nullptr : &mutex;
+    std::vector<tribool> results(runs.size(), tribool::undef);
+    std::optional<size_t> winner;
+
+    if(runs.size() == 1) {
+      results[0] = solve(*runs[0], k_max, semi_decision, sigma_mutex);
+      if(results[0] != tribool::undef)
+        winner = 0;
+    } else {
+      std::mutex winner_mutex;
+      std::vector<std::thread> threads;
+      for(size_t i = 0; i < runs.size(); ++i) {
+        threads.emplace_back([&, i]() {
+          results[i] = solve(*runs[i], k_max, semi_decision, sigma_mutex);
+          if(results[i] == tribool::undef)
+            return;
+
+          // the first definitive answer wins, and stops the other runs
+          std::lock_guard lock{winner_mutex};
+          if(winner)
+            return;
+          winner = i;
+          for(size_t j = 0; j < runs.size(); ++j)
+            if(j != i)
+              runs[j]->interrupt();
+        });
+      }
+
+      for(auto &t : threads)
+        t.join();
+    }
 
-    for(size_t k = 0; !interrupt_flag && k <= k_max; last_bound = k++)
+    // only keep the run that gave the answer (or the first one)
+    size_t chosen = winner.value_or(0);
+    {
+      std::lock_guard lock{runs_mutex};
+      std::swap(runs[0], runs[chosen]);
+      runs.resize(1);
+    }
+
+    last_bound = runs[0]->last_bound;
+    model_size = runs[0]->model_size;
+    direct_encoding = runs[0]->direct.has_value();
+    model = results[chosen] == true;
+
+    return results[chosen];
+  }
+
+  tribool solver::_solver_t::solve(
+    run_t &run, size_t k_max, bool semi_decision, std::mutex *sigma_mutex
+  ) {
+    encoder::encoder &enc = run.enc;
+    black::sat::solver &sat = *run.sat;
+    scope &xi = run.xi;
+
+    std::unique_lock<std::mutex> lock;
+    if(sigma_mutex)
+      lock = std::unique_lock{*sigma_mutex};
+
+    // run the SAT solver without holding the lock on the alphabet. 
+    // Backends may give wrong answers if interrupted while not solving (e.g.
+    // during the translation of a formula), so answers given after an 
+    // interruption are discarded. The formulas given to `check` must 
+    // already be translated, so that the alphabet is not touched.
+    auto unlocked = [&](auto check) -> tribool {
+      if(lock)
+        lock.unlock();
+      tribool res = check();
+      if(lock.mutex())
+        lock.lock();
+      if(run.interrupt_flag)
+        return tribool::undef;
+      return res;
+    };
+    auto is_sat = [&]() { 
+      return unlocked([&]{ return sat.is_sat(); });
+    };
+
+    // For propositional formulas, DIMACS backends get the encoding for k > 0
+    // directly as clauses (see `dimacs_encoder`). Not used when tracing, to 
+    // trace the actual formulas.
+    auto *dimacs = dynamic_cast<black::sat::dimacs::solver *>(&sat);
+    if(dimacs && !tracing)
+      run.direct = encoder::dimacs_encoder::make(enc, *dimacs);
+
+    for(size_t k = 0; !run.interrupt_flag && k <= k_max; run.last_bound = k++)
     {
       trace(k);
+      bool direct = k > 0 && run.direct;
+
       // Generating the k-unraveling.
       // If it is UNSAT, then stop with UNSAT
-      auto unrav = enc->k_unraveling(k);
-      trace(trace_t::unrav, xi, unrav);
-      sat->assert_formula(unrav);
-      if(tribool res = sat->is_sat(); !res)
+      if(direct)
+        run.direct->assert_k_unraveling(k);
+      else {
+        auto unrav = enc.k_unraveling(k);
+        trace(trace_t::unrav, xi, unrav);
+        sat.assert_formula(unrav);
+
+        if(k > 0) {
+          auto axioms = enc.loop_axioms(k);
+          trace(trace_t::loop, xi, axioms);
+          sat.assert_formula(axioms);
+        }
+      }
+      if(tribool res = is_sat(); !res)
         return res;
 
       // else, continue to check EMPTY and LOOP.
       // If the k-unrav is SAT assuming EMPTY or LOOP, then stop with SAT
-      auto empty = enc->k_empty(k);
-      auto loop = enc->k_loop(k);
-      trace(trace_t::empty, xi, empty);
-      trace(trace_t::loop, xi, loop);
-      if(sat->is_sat_with(empty || loop)) {
-        model_size = k + 1;
-        model = true;
-        
+      tribool found = tribool::undef;
+      if(direct)
+        found = unlocked([&]{ 
+          return run.direct->is_sat_with_empty_or_loop(k); 
+        });
+      else {
+        auto empty = enc.k_empty(k);
+        auto loop = enc.k_loop(k);
+        trace(trace_t::empty, xi, empty);
+        trace(trace_t::loop, xi, loop);
+
+        // EMPTY_k || LOOP_k is translated here, and only assumed through
+        // the proposition implying it when solving without the lock. If no
+        // model is found, the proposition is falsified, so that the solver
+        // can drop the definition, which is not needed at greater bounds
+        proposition choice = encoder::encoder::empty_or_loop_prop(sigma, k);
+        sat.assert_formula(implies(choice, empty || loop));
+        found = unlocked([&]{ return sat.is_sat_with(choice); });
+        if(found != true)
+          sat.assert_formula(!choice);
+      }
+      if(found) {
+        run.model_size = k + 1;
         return true;
       }
 
       // else, generate the PRUNE
       // If the PRUNE is UNSAT, the formula is UNSAT
       if(!semi_decision) {
-        auto prune = enc->prune(k);
-        trace(trace_t::prune, xi, prune);
-        sat->assert_formula(!prune);
-        if(tribool res = sat->is_sat(); !res)
+        if(direct)
+          run.direct->assert_not_prune(k);
+        else {
+          auto prune = enc.prune(k);
+          trace(trace_t::prune, xi, prune);
+          sat.assert_formula(!prune);
+        }
+        if(tribool res = is_sat(); !res)
           return res;
       }
     } // end for
-    interrupt_flag = false;
 
     return tribool::undef;
   }
 
   void solver::_solver_t::interrupt() {
-    interrupt_flag = true;
-    sat->interrupt();
+    std::lock_guard lock{runs_mutex};
+    for(auto &run : runs)
+      run->interrupt();
   }
 
   template<hierarchy H, typename F>
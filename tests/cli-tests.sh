@@ -58,6 +58,22 @@ should_fail ./black solve -B cmsat -s -d Int -f 'x = 0'
 should_fail ./black solve -B mathsat -s -d Int -f 'exists x : Int . x = 0'
 should_fail ./black solve -s -f 'x = 0'
 
+if [[ -f tests/libtinysat.so ]]; then
+  BLACK_IPASIR_LIBRARY=tests/libtinysat.so \
+    ./black solve -B ipasir -m -f 'G F p & F !p' | grep -w SAT
+  should_fail env BLACK_IPASIR_LIBRARY=tests/libtinysat.so \
+    ./black solve -B ipasir -s -d Int -f 'x = 0'
+fi
+should_fail ./black solve -B ipasir -f 'p'
+
+if ./black --sat-backends | grep -qw z3; then
+  ./black solve -B z3 --backend-option random_seed=42 \
+    --backend-option tactic=qflia -f 'G F p & F !p' | grep -w SAT
+  should_fail ./black solve -B z3 --backend-option non-existent=1 -f 'p'
+  should_fail ./black solve -B z3 --backend-option random_seed=abc -f 'p'
+fi
+should_fail ./black solve --backend-option =1 -f 'p'
+
 ./black solve -d Int -f 'next(x) = 0' 2>&1 | grep -- '--semi-decision'
 ./black solve -d Int -f 'wnext(x) = 0' 2>&1 | grep -- '--semi-decision'
 ./black solve -d Int -f 'prev(x) = 0' 2>&1 | grep -- '--semi-decision'
@@ -99,6 +115,69 @@ echo p | ./black check -t ../tests/test-trace.json -
 ./black solve -m -o json -f 'G F p' | \
   should_fail ./black check -t - --finite -f 'G F p'
 
+# a lasso visiting p, then q and p forever
+lasso='{
+  "model": {
+    "size": 3,
+    "loop": 1,
+    "states": [
+      { "p": "true", "q": "false" },
+      { "p": "false", "q": "true" },
+      { "p": "true", "q": "false" }
+    ]
+  }
+}'
+
+# until, release and weak until across the loop boundary
+echo "$lasso" | ./black check -t - -i 2 -f 'p U q'
+echo "$lasso" | ./black check -t - -i 2 -f 'X q & X X p'
+echo "$lasso" | should_fail ./black check -t - -i 2 -f 'p U (p & q)'
+echo "$lasso" | ./black check -t - -f 'G F q & G F p'
+echo "$lasso" | should_fail ./black check -t - -f 'F G p'
+echo "$lasso" | ./black check -t - -i 2 -f 'q R (p | q)'
+echo "$lasso" | should_fail ./black check -t - -i 2 -f 'False R p'
+echo "$lasso" | ./black check -t - -i 2 -f '(p | q) W False'
+echo "$lasso" | should_fail ./black check -t - -i 2 -f 'p W False'
+
+# past operators looking back across the loop
+echo "$lasso" | ./black check -t - -i 3 -f 'Y p & Y Y q'
+echo "$lasso" | ./black check -t - -i 8 -f 'Y Y Y Y Y q'
+echo "$lasso" | should_fail ./black check -t - -i 7 -f 'Y Y Y Y Y q'
+echo "$lasso" | should_fail ./black check -t - -i 2 -f 'Y Y Y q'
+echo "$lasso" | ./black check -t - -i 2 -f 'Z Z Z q'
+echo "$lasso" | ./black check -t - -i 10 -f 'H (p | q) & !O (p & q)'
+echo "$lasso" | ./black check -t - -i 9 -f 'q S p'
+echo "$lasso" | ./black check -t - -i 9 -f '(p | q) S (p & Z False)'
+echo "$lasso" | should_fail ./black check -t - -i 9 -f 'q S (p & Z False)'
+echo "$lasso" | ./black check -t - -f 'G (q -> Y p) & G (p -> (Z False | Y q))'
+
+# a finite trace, where the weak tomorrow holds at the last state
+finite='{
+  "model": {
+    "size": 2,
+    "states": [
+      { "p": "true" },
+      { "p": "false" }
+    ]
+  }
+}'
+
+echo "$finite" | ./black check -t - --finite -f 'X wX False'
+echo "$finite" | should_fail ./black check -t - --finite -f 'X X True'
+echo "$finite" | ./black check -t - --finite -f 'G (p -> wX !p) & F G !p'
+echo "$finite" | ./black check -t - --finite -i 1 -f 'wX False & !p'
+echo "$finite" | should_fail ./black check -t - --finite -i 1 -f 'X True'
+echo "$finite" | ./black check -t - --finite -f 'p U !p'
+echo "$finite" | should_fail ./black check -t - --finite -f 'p W False'
+
+# the models found by the solver pass the check
+for f in 'G F p & G (p -> Y !p) & (q U (r & O !q))' \
+         'G (p <-> X !p) & F G (q R r) & F (s S (p & Z Z False))'; do
+  ./black solve -m -o json -f "$f" | ./black check -t - -f "$f"
+  ./black solve -m --finite -o json -f "$f" | \
+    ./black check -t - --finite -f "$f"
+done
+
 cat <<END | should_fail ./black check -t - -e SAT -f 'p'
 {
   "result": "UNSAT"
@@ -0,0 +1,444 @@
+//
+// BLACK - Bounded Ltl sAtisfiability ChecKer
+//
+// (C) 2020 Nicola Gigante
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+// A tiny CDCL SAT solver exposing the IPASIR interface, used only for testing.
+//
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+extern "C" {
+  const char * ipasir_signature();
+  void * ipasir_init();
+  void ipasir_release(void * solver);
+  void ipasir_add(void * solver, int32_t lit_or_zero);
+  void ipasir_assume(void * solver, int32_t lit);
+  int ipasir_solve(void * solver);
+  int32_t ipasir_val(void * solver, int32_t lit);
+  int ipasir_failed(void * solver, int32_t lit);
+  void ipasir_set_terminate(
+    void * solver, void * data, int (*terminate)(void * data)
+  );
+  void ipasir_set_learn(
+    void * solver, void * data, int max_length,
+    void (*learn)(void * data, int32_t * clause)
+  );
+}
+
+namespace {
+
+  // literals are encoded as 2 * var + sign, with sign = 1 for negative
+  using lit_t = uint32_t;
+
+  inline lit_t mklit(int32_t l) {
+    return l > 0 ? lit_t(2 * l) : lit_t(2 * -l + 1);
+  }
+  inline lit_t neg(lit_t l) { return l ^ 1; }
+  inline uint32_t var(lit_t l) { return l >> 1; }
+
+  enum : int8_t { l_undef = 0, l_true = 1, l_false = -1 };
+
+  struct tiny_solver
+  {
+    std::vector<std::vector<lit_t>> clauses;
+    std::vector<std::vector<uint32_t>> watches; // per literal
+    std::vector<int8_t> assigns;  // per var
+    std::vector<int> levels;      // per var
+    std::vector<int> reasons;     // per var, clause index or -1
+    std::vector<double> activity; // per var
+    std::vector<int8_t> phase;    // per var
+    std::vector<int8_t> model;    // per var
+    std::vector<lit_t> trail;
+    std::vector<size_t> trail_lim;
+    std::vector<lit_t> assumptions;
+    std::vector<lit_t> failed;
+    std::vector<lit_t> adding;
+    size_t qhead = 0;
+    double var_inc = 1.0;
+    bool unsat = false;
+    void *term_data = nullptr;
+    int (*term)(void *) = nullptr;
+
+    void ensure(uint32_t v) {
+      if(v < assigns.size())
+        return;
+      assigns.resize(v + 1, l_undef);
+      levels.resize(v + 1, 0);
+      reasons.resize(v + 1, -1);
+      activity.resize(v + 1, 0);
+      phase.resize(v + 1, l_false);
+      model.resize(v + 1, l_undef);
+      watches.resize(2 * (v + 1));
+    }
+
+    int8_t value(lit_t l) const {
+      int8_t a = assigns[var(l)];
+      return (l & 1) ? int8_t(-a) : a;
+    }
+
+    int level() const { return int(trail_lim.size()); }
+
+    void enqueue(lit_t l, int reason) {
+      assigns[var(l)] = (l & 1) ? l_false : l_true;
+      levels[var(l)] = level();
+      reasons[var(l)] = reason;
+      trail.push_back(l);
+    }
+
+    void backtrack(int lvl) {
+      if(level() <= lvl)
+        return;
+      for(size_t i = trail.size(); i > trail_lim[lvl]; --i) {
+        uint32_t v = var(trail[i - 1]);
+        phase[v] = assigns[v];
+        assigns[v] = l_undef;
+        reasons[v] = -1;
+      }
+      trail.resize(trail_lim[lvl]);
+      trail_lim.resize(lvl);
+      qhead = trail.size();
+    }
+
+    // returns the conflicting clause index or -1
+    int propagate() {
+      while(qhead < trail.size()) {
+        lit_t p = trail[qhead++];
+        lit_t falsified = neg(p);
+        std::vector<uint32_t> &ws = watches[falsified];
+        size_t i = 0, j = 0;
+        while(i < ws.size()) {
+          uint32_t ci = ws[i++];
+          std::vector<lit_t> &c = clauses[ci];
+          if(c[0] == falsified)
+            std::swap(c[0], c[1]);
+          if(value(c[0]) == l_true) {
+            ws[j++] = ci;
+            continue;
+          }
+          bool found = false;
+          for(size_t k = 2; k < c.size(); ++k) {
+            if(value(c[k]) != l_false) {
+              std::swap(c[1], c[k]);
+              watches[c[1]].push_back(ci);
+              found = true;
+              break;
+            }
+          }
+          if(found)
+            continue;
+          ws[j++] = ci;
+          if(value(c[0]) == l_false) {
+            while(i < ws.size())
+              ws[j++] = ws[i++];
+            ws.resize(j);
+            qhead = trail.size();
+            return int(ci);
+          }
+          enqueue(c[0], int(ci));
+        }
+        ws.resize(j);
+      }
+      return -1;
+    }
+
+    void bump(uint32_t v) {
+      activity[v] += var_inc;
+      if(activity[v] > 1e100) {
+        for(double &a : activity)
+          a *= 1e-100;
+        var_inc *= 1e-100;
+      }
+    }
+
+    // first-UIP conflict analysis
+    std::vector<lit_t> analyze(int confl, int &bt_level) {
+      std::vector<lit_t> learnt(1);
+      std::vector<char> seen(assigns.size(), 0);
+      int counter = 0;
+      lit_t p = 0;
+      bool first = true;
+      size_t index = trail.size();
+      do {
+        std::vector<lit_t> const&c = clauses[size_t(confl)];
+        for(size_t k = first ? 0 : 1; k < c.size(); ++k) {
+          lit_t q = c[k];
+          uint32_t v = var(q);
+          if(!seen[v] && levels[v] > 0) {
+            seen[v] = 1;
+            bump(v);
+            if(levels[v] >= level())
+              counter++;
+            else
+              learnt.push_back(q);
+          }
+        }
+        first = false;
+        while(!seen[var(trail[--index])]);
+        p = trail[index];
+        confl = reasons[var(p)];
+        seen[var(p)] = 0;
+        counter--;
+        if(counter > 0) {
+          // the reason clause must have p as its first literal
+          std::vector<lit_t> &r = clauses[size_t(confl)];
+          if(r[0] != p)
+            for(size_t k = 1; k < r.size(); ++k)
+              if(r[k] == p) { std::swap(r[0], r[k]); break; }
+        }
+      } while(counter > 0);
+      learnt[0] = neg(p);
+
+      bt_level = 0;
+      size_t max_i = 1;
+      for(size_t k = 1; k < learnt.size(); ++k) {
+        if(levels[var(learnt[k])] > bt_level) {
+          bt_level = levels[var(learnt[k])];
+          max_i = k;
+        }
+      }
+      if(learnt.size() > 1)
+        std::swap(learnt[1], learnt[max_i]);
+      var_inc *= 1.05;
+      return learnt;
+    }
+
+    // collect the assumptions responsible for the falsification of p
+    void analyze_final(lit_t p) {
+      failed.clear();
+      failed.push_back(p);
+      if(level() == 0)
+        return;
+      std::vector<char> seen(assigns.size(), 0);
+      seen[var(p)] = 1;
+      for(size_t i = trail.size(); i > trail_lim[0]; --i) {
+        uint32_t v = var(trail[i - 1]);
+        if(!seen[v])
+          continue;
+        if(reasons[v] == -1) {
+          if(levels[v] > 0)
+            failed.push_back(neg(trail[i - 1]));
+        } else {
+          std::vector<lit_t> const&c = clauses[size_t(reasons[v])];
+          for(size_t k = 1; k < c.size(); ++k)
+            if(levels[var(c[k])] > 0)
+              seen[var(c[k])] = 1;
+        }
+        seen[v] = 0;
+      }
+    }
+
+    int attach(std::vector<lit_t> c) {
+      uint32_t ci = uint32_t(clauses.size());
+      watches[c[0]].push_back(ci);
+      watches[c[1]].push_back(ci);
+      clauses.push_back(std::move(c));
+      return int(ci);
+    }
+
+    void add_clause(std::vector<lit_t> c) {
+      if(unsat)
+        return;
+      backtrack(0);
+      std::sort(c.begin(), c.end());
+      c.erase(std::unique(c.begin(), c.end()), c.end());
+      std::vector<lit_t> kept;
+      for(size_t i = 0; i < c.size(); ++i) {
+        if(i + 1 < c.size() && c[i + 1] == neg(c[i]))
+          return; // tautology
+        if(value(c[i]) == l_true)
+          return;
+        if(value(c[i]) == l_undef)
+          kept.push_back(c[i]);
+      }
+      if(kept.empty()) {
+        unsat = true;
+        return;
+      }
+      if(kept.size() == 1) {
+        enqueue(kept[0], -1);
+        if(propagate() != -1)
+          unsat = true;
+        return;
+      }
+      attach(std::move(kept));
+    }
+
+    int pick_branch() {
+      int best = -1;
+      double best_act = -1;
+      for(uint32_t v = 1; v < assigns.size(); ++v) {
+        if(assigns[v] == l_undef && activity[v] > best_act) {
+          best = int(v);
+          best_act = activity[v];
+        }
+      }
+      return best;
+    }
+
+    int solve() {
+      failed.clear();
+      std::vector<lit_t> assumps = std::move(assumptions);
+      assumptions.clear();
+      if(unsat)
+        return 20;
+      for(lit_t a : assumps)
+        ensure(var(a));
+      backtrack(0);
+      if(propagate() != -1) {
+        unsat = true;
+        return 20;
+      }
+
+      uint64_t conflicts = 0;
+      uint64_t restart_limit = 100;
+      while(true) {
+        int confl = propagate();
+        if(confl != -1) {
+          conflicts++;
+          if(level() == 0) {
+            unsat = true;
+            return 20;
+          }
+          int bt_level = 0;
+          std::vector<lit_t> learnt = analyze(confl, bt_level);
+          backtrack(bt_level);
+          if(learnt.size() == 1)
+            enqueue(learnt[0], -1);
+          else {
+            lit_t first = learnt[0];
+            int ci = attach(std::move(learnt));
+            enqueue(first, ci);
+          }
+          if(term && (conflicts % 64) == 0 && term(term_data)) {
+            backtrack(0);
+            return 0;
+          }
+          continue;
+        }
+
+        if(conflicts >= restart_limit) {
+          restart_limit += restart_limit / 2;
+          backtrack(0);
+          continue;
+        }
+
+        if(size_t(level()) < assumps.size()) {
+          lit_t a = assumps[size_t(level())];
+          if(value(a) == l_true) {
+            trail_lim.push_back(trail.size());
+            continue;
+          }
+          if(value(a) == l_false) {
+            analyze_final(neg(a));
+            for(lit_t &f : failed)
+              f = neg(f);
+            backtrack(0);
+            return 20;
+          }
+          trail_lim.push_back(trail.size());
+          enqueue(a, -1);
+          continue;
+        }
+
+        int v = pick_branch();
+        if(v == -1) {
+          for(uint32_t u = 1; u < assigns.size(); ++u)
+            model[u] = assigns[u];
+          backtrack(0);
+          return 10;
+        }
+        trail_lim.push_back(trail.size());
+        enqueue(
+          phase[size_t(v)] == l_true ? lit_t(2 * v) : lit_t(2 * v + 1), -1
+        );
+      }
+    }
+  };
+}
+
+extern "C" {
+
+  const char * ipasir_signature() {
+    return "tinysat";
+  }
+
+  void * ipasir_init() {
+    return new tiny_solver;
+  }
+
+  void ipasir_release(void * s) {
+    delete static_cast<tiny_solver *>(s);
+  }
+
+  void ipasir_add(void * s, int32_t lit) {
+    tiny_solver *solver = static_cast<tiny_solver *>(s);
+    if(lit == 0) {
+      solver->add_clause(std::move(solver->adding));
+      solver->adding.clear();
+      return;
+    }
+    solver->ensure(var(mklit(lit)));
+    solver->adding.push_back(mklit(lit));
+  }
+
+  void ipasir_assume(void * s, int32_t lit) {
+    tiny_solver *solver = static_cast<tiny_solver *>(s);
+    solver->ensure(var(mklit(lit)));
+    solver->assumptions.push_back(mklit(lit));
+  }
+
+  int ipasir_solve(void * s) {
+    return static_cast<tiny_solver *>(s)->solve();
+  }
+
+  int32_t ipasir_val(void * s, int32_t lit) {
+    tiny_solver *solver = static_cast<tiny_solver *>(s);
+    uint32_t v = uint32_t(lit > 0 ? lit : -lit);
+    if(v >= solver->model.size() || solver->model[v] == l_undef)
+      return 0;
+    bool positive = solver->model[v] == l_true;
+    return positive ? lit : -lit;
+  }
+
+  int ipasir_failed(void * s, int32_t lit) {
+    tiny_solver *solver = static_cast<tiny_solver *>(s);
+    lit_t l = mklit(lit);
+    return std::find(solver->failed.begin(), solver->failed.end(), l) !=
+           solver->failed.end();
+  }
+
+  void ipasir_set_terminate(
+    void * s, void * data, int (*terminate)(void * data)
+  ) {
+    tiny_solver *solver = static_cast<tiny_solver *>(s);
+    solver->term_data = data;
+    solver->term = terminate;
+  }
+
+  void ipasir_set_learn(
+    void *, void *, int, void (*)(void *, int32_t *)
+  ) { }
+}
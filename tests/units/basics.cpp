@@ -28,6 +28,8 @@
 #include <string>
 #include <type_traits>
 #include <ranges>
+#include <thread>
+#include <vector>
 
 using namespace std::literals;
 using namespace black::logic;
@@ -64,6 +66,39 @@ TEST_CASE("New API") {
     REQUIRE(c == d);
   }
 
+  SECTION("Concurrent alphabet") {
+    REQUIRE(!sigma.is_concurrent());
+
+    alphabet csigma{alphabet::concurrent};
+    REQUIRE(csigma.is_concurrent());
+
+    auto build = [&](int i) {
+      formula<LTL> f = csigma.top();
+      for(int j = 0; j < 200; ++j) {
+        proposition p = csigma.proposition(j);
+        f = f && F(p || X(p));
+      }
+      return std::pair{f, csigma.proposition(i)};
+    };
+
+    std::vector<std::pair<formula<LTL>, proposition>> results(8, 
+      std::pair{csigma.top(), csigma.proposition(0)}
+    );
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 8; ++i)
+      threads.emplace_back([&, i]() { results[size_t(i)] = build(i); });
+    for(auto &t : threads)
+      t.join();
+
+    for(int i = 0; i < 8; ++i) {
+      REQUIRE(results[size_t(i)].first == results[0].first);
+      REQUIRE(results[size_t(i)].second == csigma.proposition(i));
+    }
+
+    alphabet moved = std::move(csigma);
+    REQUIRE(moved.is_concurrent());
+  }
+
   SECTION("Leaf storage kinds") {
     static_assert(!std::is_constructible_v<formula<LTL>, variable>);
     static_assert(!std::is_assignable_v<formula<LTL>, variable>);
@@ -553,6 +588,18 @@ TEST_CASE("New API") {
       p && !p && x > x && exists({x[s]}, x > x) && F(F(top)),
       syntax_element::boolean, quantifier<FO>::type::forall{}
     ));
+    REQUIRE(!has_any_element_of(
+      p && !p && x > x, syntax_element::boolean, syntax_element::exists
+    ));
+    REQUIRE(has_any_element_of<past>(X(p) && Y(p)));
+    REQUIRE(!has_any_element_of<past>(X(p) && F(p)));
+
+    // heavily shared formulas are not walked
+    formula<LTL> f = p;
+    for(int i = 0; i < 200; ++i)
+      f = f || !f;
+    REQUIRE(!has_any_element_of(f, syntax_element::tomorrow));
+    REQUIRE(has_any_element_of(X(f), syntax_element::tomorrow));
   }
 
   SECTION("big_and, big_or, etc...") {
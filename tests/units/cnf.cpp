@@ -28,6 +28,7 @@
 #include <black/logic/prettyprint.hpp>
 #include <black/solver/solver.hpp>
 #include <black/logic/cnf.hpp>
+#include <black/support/range.hpp>
 #include <black/internal/debug/random_formula.hpp>
 
 using namespace black::logic;
@@ -107,8 +108,167 @@ TEST_CASE("CNF Translation")
         INFO("CNF: " << to_string(fc));
         
         REQUIRE(!s.solve(xi, !implies(fc,f)));
+
+        formula<propositional> pc = to_formula(
+          sigma, black::to_cnf(f, black::tseitin_mode::polarity_aware)
+        );
+
+        INFO("Polarity-aware CNF: " << to_string(pc));
+
+        REQUIRE(!s.solve(xi, !implies(pc,f)));
+        REQUIRE(s.solve(xi, pc));
       }      
     }   
   }
+
+  SECTION("Incremental CNF") {
+    using namespace black_internal::cnf;
+
+    proposition p = sigma.proposition("p");
+    proposition q = sigma.proposition("q");
+    proposition r = sigma.proposition("r");
+
+    tseitin_encoder enc;
+
+    cnf c1 = enc.to_cnf(implies(p && q, r));
+    REQUIRE(c1.size() == 7);
+
+    cnf c2 = enc.to_cnf(implies(p && q, r));
+    REQUIRE(c2.size() == 1);
+
+    cnf c3 = enc.to_cnf((p && q) || r);
+    REQUIRE(c3.size() == 1);
+
+    enc.clear();
+
+    cnf c4 = enc.to_cnf(implies(p && q, r));
+    REQUIRE(c4.size() == 7);
+  }
+
+  SECTION("Polarity-aware incremental CNF") {
+    using namespace black_internal::cnf;
+
+    proposition p = sigma.proposition("p");
+    proposition q = sigma.proposition("q");
+    proposition r = sigma.proposition("r");
+
+    tseitin_encoder enc{tseitin_mode::polarity_aware};
+
+    cnf c1 = enc.to_cnf(r || (p && q));
+    REQUIRE(c1.size() == 3);
+
+    cnf c2 = enc.to_cnf((p && q) || !r);
+    REQUIRE(c2.size() == 1);
+
+    // `p && q` now occurs negatively, so the other direction is added
+    cnf c3 = enc.to_cnf(implies(p && q, r));
+    REQUIRE(c3.size() == 3);
+
+    cnf c4 = enc.to_cnf(iff(p && q, r));
+    REQUIRE(c4.size() == 3);
+
+    cnf c5 = enc.to_transient_cnf(iff(p || q, r));
+    REQUIRE(c5.size() == 6);
+
+    cnf c6 = enc.to_cnf(iff(p || q, r));
+    REQUIRE(c6.size() == 6);
+  }
+
+  SECTION("N-ary gates") {
+    using namespace black_internal::cnf;
+
+    proposition p1 = sigma.proposition("p1");
+    proposition p2 = sigma.proposition("p2");
+    proposition p3 = sigma.proposition("p3");
+    proposition p4 = sigma.proposition("p4");
+    proposition r = sigma.proposition("r");
+
+    tseitin_encoder enc;
+
+    // top-level conjunctions become unit clauses
+    cnf c1 = enc.to_cnf(p1 && p2 && p3 && p4);
+    REQUIRE(c1.size() == 4);
+
+    // a chain of conjunctions is a single gate with n + 1 clauses
+    cnf c2 = enc.to_cnf(implies(r, p1 && p2 && p3 && p4));
+    REQUIRE(c2.size() == 9);
+
+    // top-level disjunctions become a single clause
+    cnf c3 = enc.to_cnf(r || !(p1 || p2 || !p3));
+    REQUIRE(c3.size() == 5);
+    REQUIRE(c3[c3.size() - 1].size() == 2);
+  }
+
+  SECTION("Flat storage") {
+    using namespace black_internal::cnf;
+
+    proposition p = sigma.proposition("p");
+    proposition q = sigma.proposition("q");
+    proposition r = sigma.proposition("r");
+
+    cnf c = {{{true, p}, {false, q}}, {}, {{true, r}}};
+    c.add_clause({{false, p}});
+    
+    REQUIRE(c.size() == 4);
+    REQUIRE(c.literals().size() == 4);
+    REQUIRE(c[0].size() == 2);
+    REQUIRE(c[1].empty());
+    REQUIRE(c[3][0].prop == p);
+
+    size_t n = 0;
+    for(std::span<literal const> cl : c)
+      n += cl.size();
+    REQUIRE(n == 4);
+
+    REQUIRE(to_formula(sigma, c) == ((p || !q) && sigma.bottom() && r && !p));
+  }
+
+  SECTION("Long chains") {
+    using namespace black_internal::cnf;
+
+    proposition r = sigma.proposition("r");
+    formula<propositional> chain = 
+      big_and(sigma, black::range(0, 20000), [&](size_t i) {
+        return sigma.proposition(i);
+      });
+    
+    REQUIRE(remove_booleans(chain && sigma.top()) == chain);
+    REQUIRE(black::to_cnf(chain).size() == 20000);
+    REQUIRE(black::to_cnf(implies(r, chain)).size() == 20005);
+  }
+
+  SECTION("Chains sharing nodes") {
+    using namespace black_internal::cnf;
+
+    // each node of the chain occurs twice in the next one, so expanding
+    // the chain as a tree would take 2^20 operands
+    proposition r = sigma.proposition("r");
+    formula<propositional> shared = sigma.proposition(0);
+    for(size_t i = 1; i <= 20; ++i)
+      shared = shared || (shared || sigma.proposition(i));
+
+    cnf clauses = black::to_cnf(shared);
+    REQUIRE(clauses.size() == 1);
+    REQUIRE(clauses[0].size() == 21);
+
+    REQUIRE(black::to_cnf(!shared && r).size() == 22);
+    REQUIRE(black::to_cnf(implies(r, shared)).literals().size() < 100);
+  }
+
+  SECTION("Deep formulas") {
+    using namespace black_internal::cnf;
+
+    // alternating, so that no chain can be flattened into a single gate
+    formula<propositional> deep = sigma.proposition(0);
+    for(size_t i = 1; i <= 20000; ++i) {
+      proposition p = sigma.proposition(i);
+      if(i % 2)
+        deep = p && !deep;
+      else
+        deep = p || !deep;
+    }
+
+    REQUIRE(black::to_cnf(deep).size() == 59998);
+  }
   
 }
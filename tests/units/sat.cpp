@@ -24,11 +24,67 @@
 #include <catch.hpp>
 #include <black/solver/solver.hpp>
 #include <black/sat/solver.hpp>
+#include <black/logic/prettyprint.hpp>
+#include <black/internal/debug/random_formula.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#ifdef BLACK_TESTS_IPASIR_LIBRARY
+  #include <black/sat/backends/ipasir.hpp>
+#endif
+
+#ifdef BLACK_TESTS_IPASIR_LIBRARY
+//
+// This comes first so that the other tests below also test the IPASIR 
+// backend, which is available only after loading a library
+//
+TEST_CASE("IPASIR backend") {
+  using black::sat::backends::ipasir;
+
+  REQUIRE(ipasir::load("non-existent-library.so").has_value());
+  REQUIRE(!ipasir::load(BLACK_TESTS_IPASIR_LIBRARY).has_value());
+  REQUIRE(black::sat::solver::backend_exists("ipasir"));
+
+  black::alphabet sigma;
+  black::scope xi{sigma};
+
+  auto p = sigma.proposition("p");
+  auto q = sigma.proposition("q");
+
+  SECTION("License note") {
+    auto slv = black::sat::solver::get_solver("ipasir", xi);
+    auto license = slv->license();
+    REQUIRE(license.has_value());
+    REQUIRE(license->find("tinysat") != std::string::npos);
+  }
+
+  SECTION("LTL satisfiability") {
+    using namespace black::logic;
+
+    for(auto loops : {black::loop_encoding::pairwise, 
+                      black::loop_encoding::compact}) {
+      black::solver slv;
+      slv.set_sat_backend("ipasir");
+      slv.set_loop_encoding(loops);
+
+      REQUIRE(slv.solve(xi, G(F(p)) && F(!p)) == true);
+      REQUIRE(slv.model()->loop() < slv.model()->size());
+      REQUIRE(slv.solve(xi, G(p) && F(!p), false, 10) == false);
+      REQUIRE(slv.solve(xi, X(q) && !q && G(implies(q, X(!q)))) == true);
+      REQUIRE(slv.solve(xi, !p && X(X(p)) && G(iff(q, X(!q)))) == true);
+    }
+  }
+}
+#endif
 
 TEST_CASE("SAT backends") {
 
   std::vector<std::string> backends = {
-    "z3", "mathsat", "cmsat", "minisat", "cvc5"
+    "z3", "mathsat", "cmsat", "minisat", "cvc5", "ipasir"
   };
 
   black::alphabet sigma;
@@ -60,3 +116,366 @@ TEST_CASE("SAT backends") {
   }
   
 }
+
+TEST_CASE("SAT backends assumptions") {
+
+  std::vector<std::string> backends = {
+    "z3", "mathsat", "cmsat", "minisat", "cvc5", "ipasir"
+  };
+
+  black::alphabet sigma;
+  black::scope xi{sigma};
+
+  using assumptions_t = std::vector<black::logic::formula<black::logic::FO>>;
+
+  auto p = sigma.proposition("p");
+  auto q = sigma.proposition("q");
+  auto r = sigma.proposition("r");
+
+  for(auto backend : backends) {
+    DYNAMIC_SECTION("SAT backend: " << backend) {
+      if(black::sat::solver::backend_exists(backend)) {
+        auto slv = black::sat::solver::get_solver(backend, xi);
+
+        slv->assert_formula(implies(p, q));
+
+        REQUIRE(slv->is_sat_with(assumptions_t{p, !q}) == false);
+        REQUIRE(slv->is_sat_with(assumptions_t{p}) == true);
+        REQUIRE(slv->value(q) == true);
+
+        REQUIRE(slv->is_sat_with(p && !q) == false);
+        REQUIRE(slv->is_sat_with(assumptions_t{p && !q, r}) == false);
+        REQUIRE(slv->is_sat_with(assumptions_t{q || r, !q}) == true);
+        REQUIRE(slv->value(r) == true);
+
+        // nothing is left asserted by the previous calls
+        REQUIRE(slv->is_sat_with(assumptions_t{!q, !r}) == true);
+        REQUIRE(slv->value(p) == false);
+        REQUIRE(slv->is_sat());
+      }
+    }
+  }
+  
+}
+
+TEST_CASE("SAT backends failed assumptions") {
+
+  std::vector<std::string> backends = {
+    "z3", "mathsat", "cmsat", "minisat", "cvc5", "ipasir"
+  };
+
+  black::alphabet sigma;
+  black::scope xi{sigma};
+
+  using assumptions_t = std::vector<black::logic::formula<black::logic::FO>>;
+
+  auto p = sigma.proposition("p");
+  auto q = sigma.proposition("q");
+  auto r = sigma.proposition("r");
+
+  // the failed assumptions are a subset of the given ones, and contain
+  // those without which the assertions become satisfiable
+  auto check = [](assumptions_t const& failed, assumptions_t const& given,
+                  assumptions_t const& needed) {
+    for(auto a : failed)
+      REQUIRE(std::find(given.begin(), given.end(), a) != given.end());
+    for(auto a : needed)
+      REQUIRE(std::find(failed.begin(), failed.end(), a) != failed.end());
+  };
+
+  for(auto backend : backends) {
+    DYNAMIC_SECTION("SAT backend: " << backend) {
+      if(black::sat::solver::backend_exists(backend)) {
+        auto slv = black::sat::solver::get_solver(backend, xi);
+
+        slv->assert_formula(implies(p, q));
+
+        assumptions_t literals = {r, p, !q};
+        REQUIRE(slv->is_sat_with(literals) == false);
+        check(slv->failed_assumptions(), literals, {p, !q});
+
+        assumptions_t complex = {r, p && !q};
+        REQUIRE(slv->is_sat_with(complex) == false);
+        check(slv->failed_assumptions(), complex, {p && !q});
+
+        assumptions_t mixed = {q || r, p, !q, !r};
+        REQUIRE(slv->is_sat_with(mixed) == false);
+        check(slv->failed_assumptions(), mixed, {!q});
+      }
+    }
+  }
+
+}
+
+TEST_CASE("SAT backends options") {
+
+  SECTION("Option values") {
+    using black::sat::option_value;
+    using black::sat::parse_option_value;
+    using black::sat::option_as;
+    using black::sat::to_string;
+
+    REQUIRE(parse_option_value("true") == option_value{true});
+    REQUIRE(parse_option_value("false") == option_value{false});
+    REQUIRE(parse_option_value("42") == option_value{int64_t{42}});
+    REQUIRE(parse_option_value("-1") == option_value{int64_t{-1}});
+    REQUIRE(parse_option_value("0.5") == option_value{0.5});
+    REQUIRE(parse_option_value("1e3") == option_value{1000.0});
+    REQUIRE(parse_option_value("QF_LIA") == option_value{"QF_LIA"});
+    REQUIRE(parse_option_value(" 1") == option_value{" 1"});
+    REQUIRE(parse_option_value("") == option_value{""});
+
+    REQUIRE(to_string(option_value{true}) == "true");
+    REQUIRE(to_string(option_value{int64_t{42}}) == "42");
+    REQUIRE(to_string(option_value{0.5}) == "0.5");
+    REQUIRE(to_string(option_value{"ALL"}) == "ALL");
+
+    REQUIRE(option_as<double>(option_value{int64_t{2}}) == 2.0);
+    REQUIRE(!option_as<int64_t>(option_value{2.0}).has_value());
+    REQUIRE(!option_as<bool>(option_value{"true"}).has_value());
+  }
+
+  black::alphabet sigma;
+  black::scope xi{sigma};
+
+  auto p = sigma.proposition("p");
+  auto q = sigma.proposition("q");
+
+  using option_t = std::pair<std::string, black::sat::option_value>;
+  std::vector<std::pair<std::string, std::vector<option_t>>> valid = {
+    {"z3", {{"random_seed", int64_t{42}}, {"tactic", "qflia"}}},
+    {"mathsat", {{"preprocessor.toplevel_propagation", false}}},
+    {"cmsat", {{"threads", int64_t{2}}, {"polarity", "auto"}}},
+    {"minisat", {
+      {"use_elim", true}, {"var_decay", 0.9}, {"luby_restart", false}
+    }},
+    {"cvc5", {{"logic", "QF_UF"}, {"finite-model-find", false}}}
+  };
+  
+  std::vector<std::pair<std::string, std::vector<option_t>>> invalid = {
+    {"z3", {{"random_seed", "abc"}, {"tactic", "non-existent"}}},
+    {"mathsat", {}},
+    {"cmsat", {{"threads", int64_t{0}}, {"polarity", "random"}}},
+    {"minisat", {{"var_decay", 2.0}, {"phase_saving", true}}},
+    {"cvc5", {{"logic", "non-existent"}}}
+  };
+
+  for(size_t i = 0; i < valid.size(); ++i) {
+    auto backend = valid[i].first;
+    DYNAMIC_SECTION("SAT backend: " << backend) {
+      if(black::sat::solver::backend_exists(backend)) {
+        auto slv = black::sat::solver::get_solver(backend, xi);
+
+        REQUIRE(!slv->set_option("non-existent-option", true));
+        for(auto [key, value] : invalid[i].second)
+          REQUIRE(!slv->set_option(key, value));
+        for(auto [key, value] : valid[i].second)
+          REQUIRE(slv->set_option(key, value));
+
+        slv->assert_formula(implies(p, q));
+        REQUIRE(slv->is_sat_with(p && !q) == false);
+        REQUIRE(slv->is_sat_with(p) == true);
+        REQUIRE(slv->value(q) == true);
+
+        slv->clear();
+        slv->assert_formula(p && !q);
+        REQUIRE(slv->is_sat() == true);
+        REQUIRE(slv->value(q) == false);
+      }
+    }
+  }
+
+}
+
+TEST_CASE("SAT backends translation of shared subformulas") {
+
+  std::vector<std::string> backends = { "z3", "cvc5" };
+
+  black::alphabet sigma;
+  black::scope xi{sigma};
+
+  auto x = sigma.variable("x");
+  xi.declare(x, sigma.integer_sort());
+
+  // the same subformula, translated differently when `x` is rebound
+  auto f = x > 0 && x < 1;
+  auto g = black::logic::exists({x[sigma.real_sort()]}, f);
+
+  for(auto backend : backends) {
+    DYNAMIC_SECTION("SAT backend: " << backend) {
+      if(black::sat::solver::backend_exists(backend)) {
+        auto slv = black::sat::solver::get_solver(backend, xi);
+
+        REQUIRE(slv->is_sat_with(f) == false);
+        REQUIRE(slv->is_sat_with(g) == true);
+        REQUIRE(slv->is_sat_with(f || g) == true);
+        REQUIRE(slv->is_sat_with(f) == false);
+      }
+    }
+  }
+  
+}
+
+TEST_CASE("SAT backends interruption") {
+  using namespace std::chrono_literals;
+
+  std::vector<std::string> backends = { 
+    "z3", "mathsat", "cmsat", "minisat", "ipasir"
+  };
+
+  black::alphabet sigma;
+  black::scope xi{sigma};
+
+  // the pigeonhole principle, which takes very long to be refuted by 
+  // resolution-based solvers
+  size_t holes = 12;
+  auto in = [&](size_t p, size_t h) {
+    return sigma.proposition(std::pair{p, h});
+  };
+
+  black::logic::formula<black::logic::FO> php = sigma.top();
+  for(size_t p = 0; p <= holes; ++p) {
+    black::logic::formula<black::logic::FO> somewhere = sigma.bottom();
+    for(size_t h = 0; h < holes; ++h)
+      somewhere = somewhere || in(p, h);
+    php = php && somewhere;
+  }
+  for(size_t h = 0; h < holes; ++h)
+    for(size_t p = 0; p <= holes; ++p)
+      for(size_t q = p + 1; q <= holes; ++q)
+        php = php && !(in(p, h) && in(q, h));
+
+  for(auto backend : backends) {
+    DYNAMIC_SECTION("SAT backend: " << backend) {
+      if(black::sat::solver::backend_exists(backend)) {
+        auto slv = black::sat::solver::get_solver(backend, xi);
+        slv->assert_formula(php);
+
+        std::atomic<bool> done = false;
+        black::tribool res = black::tribool::undef;
+        std::thread thread([&]{
+          res = slv->is_sat();
+          done = true;
+        });
+
+        std::this_thread::sleep_for(100ms);
+
+        // a single interrupt, as given by timeouts and portfolio runs, 
+        // which must not wait for the call to stop
+        auto start = std::chrono::steady_clock::now();
+        slv->interrupt();
+        CHECK(std::chrono::steady_clock::now() - start < 100ms);
+        while(!done && std::chrono::steady_clock::now() - start < 10s)
+          std::this_thread::sleep_for(1ms);
+        auto latency = std::chrono::steady_clock::now() - start;
+        CHECK(latency < 1s);
+
+        // if the interrupt was lost, the test fails above instead of hanging
+        while(!done) {
+          slv->interrupt();
+          std::this_thread::sleep_for(1ms);
+        }
+        thread.join();
+
+        REQUIRE(res == black::tribool::undef);
+
+        // the backend is still usable afterwards
+        slv->clear();
+        slv->assert_formula(in(0, 0));
+        REQUIRE(slv->is_sat() == true);
+      }
+    }
+  }
+
+}
+
+TEST_CASE("DIMACS direct encoding") {
+  using namespace black::logic;
+
+  std::vector<std::string> backends = { "cmsat", "minisat", "ipasir" };
+
+  black::alphabet sigma;
+  black::scope xi{sigma};
+
+  std::mt19937 gen((std::random_device())());
+  std::vector<std::string> symbols = { "p1", "p2", "p3", "p4" };
+
+  std::vector<proposition> props;
+  for(auto s : symbols)
+    props.push_back(sigma.proposition(s));
+
+  // pins a formula to the values of the model found by `slv` (the part 
+  // after the last state is free if there is no loop)
+  auto pin = [&](black::solver const& slv) {
+    auto trace = slv.model()->values(props);
+
+    formula<LTLP> pinned = sigma.top();
+    auto shift = [&](formula<LTLP> f, size_t t) {
+      for(size_t i = 0; i < t; ++i)
+        f = X(f);
+      return f;
+    };
+
+    for(size_t t = 0; t < trace.size; ++t)
+      for(size_t i = 0; i < props.size(); ++i)
+        if(trace.value(i, t) != black::tribool::undef)
+          pinned = pinned && shift(
+            trace.value(i, t) == true ? 
+              formula<LTLP>{props[i]} : formula<LTLP>{!props[i]}, t
+          );
+
+    if(trace.loop < trace.size) {
+      size_t period = trace.size - trace.loop;
+      for(auto p : props)
+        pinned = pinned && shift(G(iff(p, shift(p, period))), trace.loop);
+    }
+
+    return pinned;
+  };
+
+  for(auto backend : backends) {
+    if(!black::sat::solver::backend_exists(backend))
+      continue;
+
+    for(auto loops : {black::loop_encoding::pairwise, 
+                      black::loop_encoding::compact}) {
+      for(bool finite : {false, true}) {
+        DYNAMIC_SECTION(
+          "SAT backend: " << backend << ", finite: " << finite << 
+          ", compact: " << (loops == black::loop_encoding::compact)
+        ) {
+          // the direct encoding is not used when tracing
+          black::solver direct, formulas;
+          direct.set_sat_backend(backend);
+          formulas.set_sat_backend(backend);
+          direct.set_loop_encoding(loops);
+          formulas.set_loop_encoding(loops);
+          formulas.set_tracer([](auto){ });
+
+          for(int i = 0; i < 30; ++i) {
+            formula<LTLP> f = 
+              black::random_ltlp_formula(gen, sigma, 10, symbols);
+            INFO("Formula: " << to_string(f));
+
+            black::tribool res = direct.solve(xi, f, finite);
+            REQUIRE(res == formulas.solve(xi, f, finite));
+            REQUIRE(direct.last_direct_encoding());
+            REQUIRE(!formulas.last_direct_encoding());
+            if(res != true)
+              continue;
+            
+            REQUIRE(direct.model()->size() == formulas.model()->size());
+            
+            // the models of both encodings are models of the formula
+            for(black::solver *slv : {&direct, &formulas}) {
+              formula<LTLP> pinned = pin(*slv);
+              INFO("Model: " << to_string(pinned));
+              REQUIRE(formulas.solve(xi, f && pinned, finite) == true);
+            }
+          }
+        }
+      }
+    }
+  }
+
+}
@@ -28,10 +28,49 @@
 #include <black/logic/parser.hpp>
 #include <black/logic/prettyprint.hpp>
 #include <black/solver/solver.hpp>
+#include <black/solver/core.hpp>
 #include <black/sat/solver.hpp>
 
+#include <algorithm>
+#include <chrono>
+
 using namespace black;
 
+// replaces all the occurrences of `g` in `f` with `p`
+static formula replaced(formula f, formula g, proposition p) {
+  if(f == g)
+    return p;
+
+  return f.match(
+    [&](unary u, formula arg) -> formula {
+      return unary(u.node_type(), replaced(arg, g, p));
+    },
+    [&](binary b, formula left, formula right) -> formula {
+      return binary(
+        b.node_type(), replaced(left, g, p), replaced(right, g, p)
+      );
+    },
+    [&](otherwise) { return f; }
+  );
+}
+
+// the unary and binary subformulas of `f`, i.e. those that can be replaced
+// in an unsat core
+static void subformulas(formula f, std::vector<formula> &result) {
+  f.match(
+    [&](unary, formula arg) {
+      result.push_back(f);
+      subformulas(arg, result);
+    },
+    [&](binary, formula left, formula right) {
+      result.push_back(f);
+      subformulas(left, result);
+      subformulas(right, result);
+    },
+    [](otherwise) { }
+  );
+}
+
 TEST_CASE("Solver")
 {
   alphabet sigma; // testing move constructor and assignment
@@ -205,6 +244,263 @@ TEST_CASE("Solver")
     }
   }
 
+  SECTION("Bulk model extraction") {
+    std::vector<std::string> backends = {
+      "z3", "mathsat", "cmsat", "minisat", "cvc5"
+    };
+
+    for(auto backend : backends) {
+      DYNAMIC_SECTION("Backend: " << backend) {
+        if(black::sat::solver::backend_exists(backend)) {
+          black::solver slv;
+          slv.set_sat_backend(backend);
+
+          auto p = sigma.proposition("p");
+          auto q = sigma.proposition("q");
+          auto r = sigma.proposition("r");
+
+          REQUIRE(slv.solve(xi, !p && X(X(p)) && G(iff(q, X(!q)))) == true);
+          REQUIRE(slv.model().has_value());
+
+          auto model = *slv.model();
+          auto trace = model.values({p, q, r});
+
+          REQUIRE(trace.size == model.size());
+          REQUIRE(trace.loop == model.loop());
+          REQUIRE(trace.values.size() == 3 * model.size());
+          for(size_t t = 0; t < trace.size; ++t)
+            for(size_t i = 0; i < trace.props.size(); ++i)
+              REQUIRE(trace.value(i, t) == model.value(trace.props[i], t));
+          
+          REQUIRE(trace.value(0, 0) == false);
+          REQUIRE(trace.value(0, 2) == true);
+          REQUIRE(trace.value(2, 0) == tribool::undef);
+        }
+      }
+    }
+  }
+
+  SECTION("Portfolio") {
+    std::vector<std::string> candidates = {
+      "z3", "mathsat", "cmsat", "minisat", "cvc5"
+    };
+    std::vector<std::string> backends;
+    for(auto backend : candidates)
+      if(black::sat::solver::backend_exists(backend))
+        backends.push_back(backend);
+    
+    if(backends.size() == 1)
+      backends.push_back(backends.front());
+
+    black::solver slv;
+    REQUIRE(slv.portfolio().empty());
+
+    slv.set_portfolio(backends);
+    REQUIRE(slv.portfolio() == backends);
+
+    auto p = sigma.proposition("p");
+    auto q = sigma.proposition("q");
+
+    REQUIRE(slv.solve(xi, G(F(p)) && F(!p)) == true);
+    REQUIRE(slv.model().has_value());
+    REQUIRE(slv.model()->size() == 2);
+    REQUIRE(
+      std::find(
+        backends.begin(), backends.end(), slv.last_sat_backend()
+      ) != backends.end()
+    );
+
+    REQUIRE(slv.solve(xi, G(p) && F(!p), 10) == false);
+    REQUIRE(!slv.model().has_value());
+
+    REQUIRE(slv.solve(xi, X(q) && !q && G(implies(q, X(!q)))) == true);
+
+    alphabet csigma{alphabet::concurrent};
+    scope cxi{csigma};
+
+    auto cp = csigma.proposition("p");
+    REQUIRE(slv.solve(cxi, G(F(cp)) && F(!cp)) == true);
+    REQUIRE(slv.solve(cxi, G(cp) && F(!cp), 10) == false);
+  }
+
+  SECTION("Timeouts") {
+    using namespace std::chrono_literals;
+
+    black::solver slv;
+    auto p = sigma.proposition("p");
+
+    // without the termination rules this never ends
+    auto start = std::chrono::steady_clock::now();
+    tribool res = slv.solve(
+      xi, G(p) && F(!p), false, std::numeric_limits<size_t>::max(), 100ms, 
+      true
+    );
+    REQUIRE(res == tribool::undef);
+    REQUIRE(std::chrono::steady_clock::now() - start < 30s);
+
+    // expired deadlines of past calls do not interrupt later ones
+    for(int i = 0; i < 100; ++i)
+      REQUIRE(slv.solve(xi, F(p), false, 10, 60s) == true);
+    REQUIRE(slv.solve(xi, G(p) && F(!p), false, 10, 1ms) != true);
+    REQUIRE(slv.solve(xi, F(!p) && X(p)) == true);
+  }
+
+  SECTION("Shared requests") {
+    black::solver slv;
+    auto p = sigma.proposition("p");
+    auto q = sigma.proposition("q");
+    auto r = sigma.proposition("r");
+
+    REQUIRE(slv.solve(xi, G(implies(p, F(q)))) == true);
+    REQUIRE(slv.last_duplicate_requests() == 0);
+
+    REQUIRE(
+      slv.solve(xi, G(implies(p, F(q))) && G(implies(r, F(q))) && F(!q)) 
+      == true
+    );
+    REQUIRE(slv.last_duplicate_requests() == 1);
+  }
+
+  SECTION("Unsat cores") {
+    black::solver slv;
+    auto p = sigma.proposition("p");
+    auto q = sigma.proposition("q");
+    auto unneeded = sigma.proposition("unneeded");
+
+    // the eventualities of the unneeded parts must not delay the PRUNE 
+    // when they are disabled
+    std::vector<std::pair<formula, bool>> tests = {
+      {G(p) && F(!p) && F(unneeded) && X(q), false},
+      {G(p) && F(!p) && F(unneeded) && X(q), true},
+      {G(F(p)) && F(G(!p)) && G(F(unneeded)) && G(F(!unneeded)) && X(q), 
+       false},
+      {G(implies(p, X(!p))) && G(implies(!p, X(p))) && G(F(unneeded)) && 
+       F(G(p)), false}
+    };
+
+    for(auto [f, finite] : tests) {
+      DYNAMIC_SECTION("Formula: " << to_string(f) << ", finite: " << finite)
+      {
+        REQUIRE(slv.solve(xi, f, finite) == false);
+
+        formula core = unsat_core(xi, f, finite);
+        REQUIRE(slv.solve(xi, core, finite) == false);
+        REQUIRE(to_string(core).find("unneeded") == std::string::npos);
+        REQUIRE(to_string(core).find("q") == std::string::npos);
+      }
+    }
+
+    // a refutation at some bound also relies on the smaller bounds, so the
+    // failed assumptions alone do not make a core
+    auto g = parse_formula(
+      sigma, "G(!(True R wX p3) U X p4) & "
+             "F(X(X !G(True U !p3) -> G p3) | !((True <-> p3) & !p2))"
+    );
+    REQUIRE(g.has_value());
+    REQUIRE(slv.solve(xi, *g, true) == false);
+    REQUIRE(slv.solve(xi, unsat_core(xi, *g, true), true) == false);
+
+    // a minimal core, where no subformula can be replaced anymore
+    tests.push_back({*g, true});
+    for(auto [f, finite] : tests) {
+      DYNAMIC_SECTION("Minimal core of: " << to_string(f) << 
+                      ", finite: " << finite) 
+      {
+        formula core = unsat_core(xi, f, finite, true);
+        REQUIRE(slv.solve(xi, core, finite) == false);
+
+        std::vector<formula> subs;
+        subformulas(core, subs);
+        auto fresh = sigma.proposition("fresh");
+        for(formula sub : subs) {
+          INFO("Core: " << to_string(core));
+          INFO("Replaced: " << to_string(sub));
+          REQUIRE(slv.solve(xi, replaced(core, sub, fresh), finite) == true);
+        }
+      }
+    }
+  }
+
+  SECTION("Loop encodings") {
+    std::vector<std::string> backends = {
+      "z3", "mathsat", "cmsat", "minisat", "cvc5"
+    };
+
+    for(auto backend : backends) {
+      DYNAMIC_SECTION("Backend: " << backend) {
+        if(black::sat::solver::backend_exists(backend)) {
+          black::solver pairwise;
+          black::solver compact;
+          pairwise.set_sat_backend(backend);
+          compact.set_sat_backend(backend);
+          compact.set_loop_encoding(black::loop_encoding::compact);
+
+          auto p = sigma.proposition("p");
+          auto q = sigma.proposition("q");
+
+          std::vector<formula> tests = {
+            G(F(p)) && F(!p), G(p) && F(!p), 
+            X(q) && !q && G(implies(q, X(!q))),
+            G(implies(p, Y(q))) && G(F(p)) && G(F(!q)),
+            G(F(p) && F(!p)) && G(implies(p, O(q))) && !q,
+            G(iff(p, X(X(p)))) && p && X(!p) && G(F(q)) && G(F(!q)),
+            U(p, q) && G(F(!p)), S(p, q) && G(!q), F(G(p)) && G(F(!p))
+          };
+
+          for(auto f : tests) {
+            DYNAMIC_SECTION("Formula: " << to_string(f)) {
+              tribool res = pairwise.solve(xi, f, false, 20);
+              REQUIRE(compact.solve(xi, f, false, 20) == res);
+
+              if(res == true) {
+                REQUIRE(compact.model()->size() == pairwise.model()->size());
+                REQUIRE(compact.model()->loop() < compact.model()->size());
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  SECTION("Backend options") {
+    black::solver slv;
+    auto p = sigma.proposition("p");
+
+    // options unknown to all the backends are refused
+    REQUIRE(!slv.set_backend_option("non-existent-option", int64_t{1}));
+    REQUIRE(slv.solve(xi, G(F(p)) && F(!p)) == true);
+
+    if(black::sat::solver::backend_exists("z3")) {
+      slv.set_sat_backend("z3");
+      REQUIRE(slv.set_backend_option("random_seed", int64_t{42}));
+      REQUIRE(slv.set_backend_option("tactic", "qflia"));
+      REQUIRE(!slv.set_backend_option("random_seed", "abc"));
+      REQUIRE(slv.solve(xi, G(F(p)) && F(!p)) == true);
+      REQUIRE(slv.solve(xi, G(p) && F(!p), false, 10) == false);
+
+      // the options must still be accepted after a change of backend
+      if(black::sat::solver::backend_exists("ipasir")) {
+        slv.set_sat_backend("ipasir");
+        REQUIRE(slv.solve(xi, G(F(p)) && F(!p)) == tribool::undef);
+      }
+    }
+
+    slv.clear_backend_options();
+    REQUIRE(slv.solve(xi, G(p) && F(!p)) == false);
+  }
+
+  SECTION("Deep formulas") {
+    black::solver slv;
+    auto p = sigma.proposition("p");
+
+    formula deep = p;
+    for(size_t i = 0; i < 20000; ++i)
+      deep = X(!deep);
+
+    REQUIRE(slv.solve(xi, deep, false, 1) == true);
+  }
+
   SECTION("Solver syntax errors") {
 
     std::vector<std::string> tests = {